@@ -0,0 +1,80 @@
+#ifndef BENCH_H_INCLUDED
+#define BENCH_H_INCLUDED
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "timing.h"
+
+/* Benchmarks are standalone, they don't need the window or the assets.
+ * Each file in `bench/` defines its benchmarks with `BENCHMARK(name) {...}`, and `bench/main.cpp` runs them.
+ * The "Benchmarks" target is built with SSE2, "Benchmarks (no SSE2)" with `-U__SSE2__`, to compare the kernels against the scalar fallbacks.
+ */
+
+namespace Bench
+{
+    using func_t = void (*)();
+
+    inline std::vector<std::pair<std::string, func_t>> &List()
+    {
+        static std::vector<std::pair<std::string, func_t>> ret;
+        return ret;
+    }
+
+    struct Registrar
+    {
+        Registrar(std::string name, func_t func)
+        {
+            List().emplace_back(std::move(name), func);
+        }
+    };
+
+    [[nodiscard]] inline const char *BuildName()
+    {
+        #ifdef __SSE2__
+        return "SSE2";
+        #else
+        return "scalar";
+        #endif
+    }
+
+    // Runs `func` `runs` times and returns the fastest run in milliseconds.
+    template <typename F> [[nodiscard]] double BestMs(int runs, F &&func)
+    {
+        double ret = 0;
+        for (int i = 0; i < runs; i++)
+        {
+            uint64_t begin = Timing::Clock();
+            func();
+            double ms = Timing::TicksToSecs(Timing::Clock() - begin) * 1000;
+            if (i == 0 || ms < ret)
+                ret = ms;
+        }
+        return ret;
+    }
+
+    [[nodiscard]] inline double MbPerSec(std::size_t bytes, double ms)
+    {
+        return bytes / (1024.0 * 1024.0) / (ms / 1000);
+    }
+
+    // Stores a value where the optimizer can't see it, so the computation that produced it isn't discarded.
+    template <typename T> inline volatile T keep_sink;
+    template <typename T> void Keep(T value)
+    {
+        static_assert(std::is_arithmetic_v<T>, "T must be arithmetic.");
+        keep_sink<T> = value;
+    }
+}
+
+#define BENCHMARK(name_) \
+    static void Bench_##name_(); \
+    static ::Bench::Registrar bench_registrar_##name_(#name_, Bench_##name_); \
+    static void Bench_##name_()
+
+#endif
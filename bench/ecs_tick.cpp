@@ -0,0 +1,87 @@
+#include "bench.h"
+#include "ecs.h"
+#include "threads.h"
+
+/* One game tick of the movement, spin and bounce systems over 100k entities.
+ * A third of the entities have `Spin`, so there are two archetypes.
+ */
+
+namespace
+{
+    struct Pos {float x, y;};
+    struct Vel {float x, y;};
+    struct Spin {float angle, speed;};
+
+    constexpr int entity_count = 100000, ticks = 200, runs = 3;
+    constexpr float dt = 1 / 60.f, world_size = 1000;
+
+    void Populate(Ecs::World &world)
+    {
+        for (int i = 0; i < entity_count; i++)
+        {
+            Pos pos{float(i % 1000), float(i / 100)};
+            Vel vel{float(i % 7) - 3, float(i % 5) - 2};
+            if (i % 3 == 0)
+                world.Create(pos, vel, Spin{0, float(i % 11)});
+            else
+                world.Create(pos, vel);
+        }
+    }
+
+    void AddSystems(Ecs::Systems &systems)
+    {
+        systems.AddEach<Pos, const Vel>([](Pos &pos, const Vel &vel)
+        {
+            pos.x += vel.x * dt;
+            pos.y += vel.y * dt;
+        });
+        systems.AddEach<Spin>([](Spin &spin)
+        {
+            spin.angle += spin.speed * dt;
+        });
+        systems.AddEach<const Pos, Vel>([](const Pos &pos, Vel &vel)
+        {
+            if (pos.x < 0 || pos.x > world_size) vel.x = -vel.x;
+            if (pos.y < 0 || pos.y > world_size) vel.y = -vel.y;
+        });
+    }
+
+    double Checksum(Ecs::World &world)
+    {
+        double ret = 0;
+        world.Each<const Pos>([&](const Pos &pos){ret += pos.x + pos.y;});
+        world.Each<const Spin>([&](const Spin &spin){ret += spin.angle;});
+        return ret;
+    }
+}
+
+BENCHMARK(ecs_tick)
+{
+    Ecs::Systems systems;
+    AddSystems(systems);
+
+    Ecs::World serial_world, pooled_world;
+    Populate(serial_world);
+    Populate(pooled_world);
+
+    Threads::Pool pool(0);
+
+    double serial_ms = Bench::BestMs(runs, [&]
+    {
+        for (int i = 0; i < ticks; i++)
+            systems.Run(serial_world);
+    }) / ticks;
+    double pooled_ms = Bench::BestMs(runs, [&]
+    {
+        for (int i = 0; i < ticks; i++)
+            systems.Run(pooled_world, &pool);
+    }) / ticks;
+
+    // Both worlds went through the same amount of ticks, and the systems don't depend on the order of entities, so they must match exactly.
+    if (Checksum(serial_world) != Checksum(pooled_world))
+        Program::Error("The pooled run doesn't match the serial one.");
+
+    std::printf("%d entities in %zu archetypes, %zu systems in %zu batches\n", entity_count, serial_world.Archetypes().size(), systems.Size(), systems.BatchCount());
+    std::printf("Without a pool: %.3f ms per tick\n", serial_ms);
+    std::printf("With %d pool thread(s): %.3f ms per tick\n", pool.ThreadCount(), pooled_ms);
+}
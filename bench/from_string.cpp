@@ -0,0 +1,95 @@
+#include <cctype>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "reflection.h"
+#include "mat.h"
+
+/* `Reflection::from_string()` on a dump shaped like `Map::ReflectedData` saved with `forward_compat`: four layers of 250K ints (1M integers).
+ * The baseline parses the same text into `StrtolInt`s, which use the `strtol`-based parser that `from_string()` had for integers before `from_chars`.
+ * The integers are where the time goes, so the rest of the baseline is the current code.
+ */
+
+namespace
+{
+    constexpr int layer_count = 4, layer_size = 250000, runs = 5;
+
+    ReflectStruct(Dump, (
+        (ivec2)(size),
+        (std::vector<std::string>)(tile_names, variant_names),
+        (std::vector<int>[layer_count])(layers),
+    ))
+
+    struct StrtolInt
+    {
+        int value = 0;
+    };
+    inline std::size_t reflection_interface_primitive_from_string(StrtolInt *obj, const char *str) // Found by ADL.
+    {
+        if (std::isspace(*str))
+            return 0;
+        char *end;
+        long ret = std::strtol(str, &end, 0);
+        if (end == str)
+            return 0;
+        obj->value = ret;
+        return end - str;
+    }
+
+    ReflectStruct(DumpStrtol, (
+        (ivec2)(size),
+        (std::vector<std::string>)(tile_names, variant_names),
+        (std::vector<StrtolInt>[layer_count])(layers),
+    ))
+}
+
+BENCHMARK(from_string)
+{
+    Dump dump;
+    dump.size = ivec2(500);
+    dump.tile_names = {"grass", "stone", "water", "sand", "wall"};
+    dump.variant_names = {"a", "b"};
+    uint32_t rng = 1;
+    for (auto &layer : dump.layers)
+    {
+        layer.resize(layer_size);
+        for (int &tile : layer)
+        {
+            rng = rng * 1664525 + 1013904223;
+            tile = int(rng >> 28) - 1; // `-1` is `Map::no_tile`, the rest are small indices, like in a real map.
+        }
+    }
+
+    Reflection::Writer writer;
+    Reflection::write_string(dump, writer);
+    const std::string &text = writer.str();
+
+    Dump parsed;
+    double current_ms = Bench::BestMs(runs, [&]
+    {
+        parsed = Dump{};
+        if (!Reflection::from_string(parsed, text.c_str()))
+            Program::Error("Unable to parse the dump.");
+    });
+
+    DumpStrtol parsed_strtol;
+    double strtol_ms = Bench::BestMs(runs, [&]
+    {
+        parsed_strtol = DumpStrtol{};
+        if (!Reflection::from_string(parsed_strtol, text.c_str()))
+            Program::Error("Unable to parse the dump with `strtol`.");
+    });
+
+    for (int i = 0; i < layer_count; i++)
+    for (int j = 0; j < layer_size; j++)
+    {
+        if (parsed.layers[i][j] != dump.layers[i][j] || parsed_strtol.layers[i][j].value != dump.layers[i][j])
+            Program::Error("The parsed dump doesn't match the original.");
+    }
+
+    std::printf("%d integers, %.1f MB of text\n", layer_count * layer_size, text.size() / (1024.0 * 1024.0));
+    std::printf("strtol (before): %6.1f ms, %4.0f MB/s\n", strtol_ms, Bench::MbPerSec(text.size(), strtol_ms));
+    std::printf("from_chars:      %6.1f ms, %4.0f MB/s\n", current_ms, Bench::MbPerSec(text.size(), current_ms));
+}
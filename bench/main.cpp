@@ -0,0 +1,37 @@
+#include <cstdio>
+#include <cstring>
+
+#include "bench.h"
+
+// Runs all benchmarks, or only those named on the command line.
+int main(int argc, char **argv)
+{
+    std::printf("Build: %s\n", Bench::BuildName());
+
+    bool found_any = 0;
+    for (const auto &[name, func] : Bench::List())
+    {
+        bool selected = argc <= 1;
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::strcmp(argv[i], name.c_str()) == 0)
+                selected = 1;
+        }
+        if (!selected)
+            continue;
+
+        found_any = 1;
+        std::printf("\n== %s ==\n", name.c_str());
+        func();
+        std::fflush(stdout);
+    }
+
+    if (!found_any)
+    {
+        std::printf("No such benchmark. Available:\n");
+        for (const auto &entry : Bench::List())
+            std::printf("  %s\n", entry.first.c_str());
+        return 1;
+    }
+    return 0;
+}
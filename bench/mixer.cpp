@@ -0,0 +1,114 @@
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "bench.h"
+#include "mixer.h"
+
+namespace
+{
+    constexpr int freq = 44100;
+
+    // A looping-friendly clip: a whole number of periods of a sine, with a bit of noise so the kernels can't shortcut anything.
+    std::shared_ptr<const Audio::Mixer::Clip> MakeClip(bool stereo, int clip_freq, float seconds)
+    {
+        std::mt19937 rng(stereo);
+        std::uniform_int_distribution<int> noise(-500, 500);
+
+        Audio::Sound sound;
+        uint32_t frames = clip_freq * seconds;
+        int channels = stereo ? 2 : 1;
+        sound.FromMemory(stereo ? Audio::Sound::stereo16 : Audio::Sound::mono16, clip_freq, frames);
+        for (uint32_t i = 0; i < frames * channels; i++)
+        {
+            int16_t value = std::lround(std::sin(i / channels * 440 * 2 * 3.14159265 / clip_freq) * 20000) + noise(rng);
+            std::memcpy(sound.Data() + i * 2, &value, 2);
+        }
+        return std::make_shared<const Audio::Mixer::Clip>(sound);
+    }
+
+    Audio::Mixer::VoiceParams Params(float gain, float pan, float pitch, bool loop)
+    {
+        Audio::Mixer::VoiceParams ret;
+        ret.gain = gain;
+        ret.pan = pan;
+        ret.pitch = pitch;
+        ret.loop = loop;
+        return ret;
+    }
+}
+
+/* `Mixer::Mix()` in 1024-frame blocks, like the stream requests them.
+ * The "voices in real time" column is how many voices one core could mix without falling behind playback.
+ */
+BENCHMARK(mixer)
+{
+    constexpr std::size_t block_frames = 1024;
+    constexpr int blocks = 200, runs = 5;
+
+    auto mono = MakeClip(0, freq, 1), stereo = MakeClip(1, freq, 1);
+    std::vector<int16_t> buffer(block_frames * 2);
+
+    for (int voice_count : {16, 256})
+    for (float pitch : {1.f, 1.1f})
+    {
+        Audio::Mixer mixer(freq);
+        for (int i = 0; i < voice_count; i++)
+            mixer.Play(i % 4 == 3 ? stereo : mono, Params(1.f / voice_count, (i % 9 - 4) / 4.f, pitch, 1));
+
+        double ms = Bench::BestMs(runs, [&]
+        {
+            for (int i = 0; i < blocks; i++)
+                mixer.Mix(buffer.data(), block_frames);
+        }) / blocks;
+
+        if (mixer.ActiveVoices() != voice_count)
+            Program::Error("Looping voices have stopped.");
+
+        double block_ms = block_frames * 1000.0 / freq;
+        std::printf("%3d voices, pitch %.1f:  %7.3f ms per block (%.1f ms of audio), %6.0f voices in real time\n",
+                    voice_count, pitch, ms, block_ms, voice_count * block_ms / ms);
+    }
+}
+
+/* Renders a short mix to `mixer_check_<build>.wav` without opening an audio device, and checks it.
+ * The files from the SSE2 and scalar builds should differ by at most 1 LSB.
+ */
+BENCHMARK(mixer_render)
+{
+    Audio::Mixer mixer(freq);
+    mixer.Play(MakeClip(0, freq, 0.5), Params(0.5, -0.5, 1, 0));
+    mixer.Play(MakeClip(1, freq / 2, 0.5), Params(0.5, 0, 1.5, 0));
+    mixer.Play(MakeClip(0, freq, 0.1), Params(0.25, 0.75, 1, 1));
+
+    std::size_t frames = freq * 2;
+    Audio::Sound sound = mixer.Render(frames);
+    if (mixer.ActiveVoices() != 1)
+        Program::Error(Str("Expected only the looping voice to remain, but ", mixer.ActiveVoices(), " voices are playing."));
+
+    std::string file_name = Str("mixer_check_", Bench::BuildName(), ".wav");
+    sound.SaveWAV(file_name);
+    Audio::Sound loaded = Audio::Sound::WAV(Utils::MemoryFile(file_name));
+    if (loaded.Format() != Audio::Sound::stereo16 || int(loaded.Frequency()) != freq || std::size_t(loaded.Samples()) != frames
+        || std::memcmp(loaded.Data(), sound.Data(), sound.Bytes()) != 0)
+        Program::Error(Str("`", file_name, "` doesn't match the rendered sound."));
+
+    // The first half second has all three voices, the last one only the looping one.
+    auto Peak = [&](std::size_t begin, std::size_t end)
+    {
+        int ret = 0;
+        for (std::size_t i = begin * 2; i < end * 2; i++)
+        {
+            int16_t value;
+            std::memcpy(&value, sound.Data() + i * 2, 2);
+            ret = std::max(ret, std::abs(int(value)));
+        }
+        return ret;
+    };
+    int peak_start = Peak(0, freq / 2), peak_end = Peak(freq * 3 / 2, frames);
+    if (peak_start == 0 || peak_end == 0 || peak_end >= peak_start)
+        Program::Error(Str("Unexpected peaks: ", peak_start, " at the start, ", peak_end, " at the end."));
+
+    std::printf("Saved `%s`: %zu frames, peak %d at the start, %d at the end.\n", file_name.c_str(), frames, peak_start, peak_end);
+}
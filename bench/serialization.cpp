@@ -0,0 +1,95 @@
+#include <array>
+#include <deque>
+#include <vector>
+
+#include "bench.h"
+#include "reflection.h"
+
+/* `to_bytes()` and `from_bytes()` on 4M ints (16 MB of payload).
+ * `std::vector<int>` takes the bulk path. `std::deque<int>` has no `data()`, so it takes the element-wise container path,
+ * which is what vectors used before the bulk path existed. `std::array`s are tuples, so they are always element-wise.
+ * `ArrayView<int>` is read in place.
+ */
+
+namespace
+{
+    constexpr std::size_t element_count = 4 << 20, payload_bytes = element_count * sizeof(int);
+    constexpr int runs = 5;
+
+    template <typename T> void Measure(const char *name, const T &object)
+    {
+        std::vector<uint8_t> buffer(Reflection::byte_buffer_size(object));
+
+        double to_ms = Bench::BestMs(runs, [&]
+        {
+            Reflection::to_bytes(object, buffer.data());
+        });
+
+        double from_cold_ms = Bench::BestMs(runs, [&]
+        {
+            T copy;
+            if (!Reflection::from_bytes(copy, buffer.data(), buffer.data() + buffer.size()))
+                Program::Error("Unable to deserialize.");
+        });
+
+        T reused;
+        double from_reused_ms = Bench::BestMs(runs, [&]
+        {
+            if (!Reflection::from_bytes(reused, buffer.data(), buffer.data() + buffer.size()))
+                Program::Error("Unable to deserialize.");
+        });
+
+        double from_reader_ms = Bench::BestMs(runs, [&]
+        {
+            constexpr std::size_t chunk_size = 64 << 10;
+            std::size_t pos = 0;
+            Reflection::Bytes::Reader reader([&](const uint8_t *&begin, const uint8_t *&end)
+            {
+                if (pos >= buffer.size())
+                    return false;
+                begin = buffer.data() + pos;
+                pos = std::min(pos + chunk_size, buffer.size());
+                end = buffer.data() + pos;
+                return true;
+            });
+            T copy;
+            if (!Reflection::from_bytes(copy, reader))
+                Program::Error("Unable to deserialize.");
+        });
+
+        std::printf("%-24s  to_bytes %6.0f MB/s   from_bytes: cold %6.0f MB/s, reused %6.0f MB/s, reader %6.0f MB/s\n", name,
+                    Bench::MbPerSec(payload_bytes, to_ms), Bench::MbPerSec(payload_bytes, from_cold_ms),
+                    Bench::MbPerSec(payload_bytes, from_reused_ms), Bench::MbPerSec(payload_bytes, from_reader_ms));
+    }
+}
+
+BENCHMARK(serialization)
+{
+    static_assert(Reflection::Interface::container_is_bulk<std::vector<int>>());
+    static_assert(!Reflection::Interface::container_is_bulk<std::deque<int>>());
+
+    std::vector<int> vec(element_count);
+    for (std::size_t i = 0; i < element_count; i++)
+        vec[i] = int(i * 2654435761u);
+
+    Measure("vector<int>, bulk", vec);
+    Measure("deque<int>, elementwise", std::deque<int>(vec.begin(), vec.end()));
+
+    std::vector<std::array<int, 4>> arrays(element_count / 4);
+    for (std::size_t i = 0; i < arrays.size(); i++)
+        arrays[i] = {vec[i*4], vec[i*4+1], vec[i*4+2], vec[i*4+3]};
+    Measure("vector<array<int,4>>", arrays);
+
+    // The view doesn't copy on reading, so this only measures `copy_to()` after it.
+    std::vector<uint8_t> buffer(Reflection::byte_buffer_size(vec));
+    Reflection::to_bytes(vec, buffer.data());
+    std::vector<int> out(element_count);
+    double view_ms = Bench::BestMs(runs, [&]
+    {
+        Reflection::ArrayView<int> view;
+        if (!Reflection::from_bytes(view, buffer.data(), buffer.data() + buffer.size()))
+            Program::Error("Unable to deserialize.");
+        view.copy_to(out.data());
+    });
+    std::printf("%-24s  from_bytes + copy_to %6.0f MB/s\n", "ArrayView<int>", Bench::MbPerSec(payload_bytes, view_ms));
+}
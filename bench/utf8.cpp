@@ -0,0 +1,60 @@
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "strings.h"
+
+/* `u8strlen()`, `u8valid16()` and `u8decode16()` on 4 MB strings.
+ * Compare the output of the "Benchmarks" target with "Benchmarks (no SSE2)" to see what the SSE2 paths give.
+ * The SSE2 paths mostly help with ASCII runs, so the inputs range from pure ASCII to pure Cyrillic.
+ */
+
+namespace
+{
+    constexpr std::size_t input_size = 4 << 20;
+    constexpr int runs = 5;
+
+    std::string Repeat(std::string_view pattern)
+    {
+        std::string ret;
+        ret.reserve(input_size + pattern.size());
+        while (ret.size() < input_size)
+            ret += pattern;
+        while (!Strings::u8isfirstbyte(ret.back())) // Don't cut the last character in half.
+            ret.pop_back();
+        ret.pop_back();
+        return ret;
+    }
+
+    void Measure(const char *name, const std::string &str)
+    {
+        if (!Strings::u8valid16(str))
+            Program::Error(Str("The `", name, "` input is not valid UTF-8."));
+
+        double strlen_ms = Bench::BestMs(runs, [&]
+        {
+            Bench::Keep(Strings::u8strlen(str));
+        });
+        double valid_ms = Bench::BestMs(runs, [&]
+        {
+            Bench::Keep(Strings::u8valid16(str));
+        });
+        std::vector<uint16_t> decoded;
+        double decode_ms = Bench::BestMs(runs, [&]
+        {
+            decoded.clear();
+            Strings::u8decode16(str, decoded);
+            Bench::Keep(decoded.size());
+        });
+
+        std::printf("%-10s  u8strlen %6.0f MB/s   u8valid16 %6.0f MB/s   u8decode16 %6.0f MB/s\n", name,
+                    Bench::MbPerSec(str.size(), strlen_ms), Bench::MbPerSec(str.size(), valid_ms), Bench::MbPerSec(str.size(), decode_ms));
+    }
+}
+
+BENCHMARK(utf8)
+{
+    Measure("ascii", Repeat("The quick brown fox jumps over the lazy dog. 0123456789\n"));
+    Measure("mixed", Repeat("Map: \xd0\x9a\xd0\xb0\xd1\x80\xd1\x82\xd0\xb0 #12, layer \xd1\x84\xd0\xbe\xd0\xbd, tile_size = 32;\n"));
+    Measure("cyrillic", Repeat("\xd0\xa1\xd1\x8a\xd0\xb5\xd1\x88\xd1\x8c \xd0\xb6\xd0\xb5 \xd0\xb5\xd1\x89\xd1\x91 \xd1\x8d\xd1\x82\xd0\xb8\xd1\x85 \xd0\xbc\xd1\x8f\xd0\xb3\xd0\xba\xd0\xb8\xd1\x85 \xd0\xb1\xd1\x83\xd0\xbb\xd0\xbe\xd0\xba.\n"));
+}
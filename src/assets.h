@@ -0,0 +1,334 @@
+#ifndef ASSETS_H_INCLUDED
+#define ASSETS_H_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "audio.h"
+#include "graphics.h"
+#include "threads.h"
+#include "timing.h"
+
+namespace Assets
+{
+    /* Loads assets in the background.
+     * Each load has two steps:
+     *   `decode()` runs on a worker thread. It can read and parse files, but must not touch OpenGL or anything the main thread uses.
+     *   `apply(result)` runs on the main thread from `Tick()`. That's where GL uploads go and where the old objects get replaced.
+     * If either step throws, the exception is rethrown from `Tick()`, as if the asset was loaded synchronously.
+     */
+    class Loader
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::function<void()>> apply_queue;
+        std::atomic_int pending{0}; // Loads that weren't applied yet.
+
+        Threads::Pool pool; // This must be the last field, so that the threads are stopped before the rest is destroyed.
+
+        void Enqueue(std::function<void()> step)
+        {
+            {
+                std::lock_guard lock(mutex);
+                apply_queue.push_back(std::move(step));
+            }
+            cv.notify_all();
+        }
+
+      public:
+        using Handle = std::shared_future<void>; // Becomes ready after `apply()` returns.
+
+        Loader(int thread_count = 0) : pool(thread_count) {} // See `Threads::Pool` for the meaning of `thread_count`.
+
+        Loader(const Loader &) = delete;
+        Loader &operator=(const Loader &) = delete;
+
+        template <typename D, typename A> Handle Load(D &&decode, A &&apply) // `apply` receives the return value of `decode` as an rvalue, if there is one.
+        {
+            using result_t = std::invoke_result_t<std::decay_t<D>>;
+
+            auto promise = std::make_shared<std::promise<void>>();
+            auto apply_ptr = std::make_shared<std::decay_t<A>>(std::forward<A>(apply)); // `std::function` needs copyable targets.
+            Handle ret = promise->get_future().share();
+            pending++;
+
+            pool.Run([this, promise, apply_ptr, decode = std::forward<D>(decode)]() mutable
+            {
+                auto Fail = [&](std::exception_ptr e)
+                {
+                    Enqueue([this, promise, e]
+                    {
+                        promise->set_exception(e);
+                        pending--;
+                        std::rethrow_exception(e);
+                    });
+                };
+
+                try
+                {
+                    std::shared_ptr<std::conditional_t<std::is_void_v<result_t>, char, result_t>> result;
+                    if constexpr (std::is_void_v<result_t>)
+                        decode();
+                    else
+                        result = std::make_shared<result_t>(decode());
+
+                    Enqueue([this, promise, apply_ptr, result]
+                    {
+                        try
+                        {
+                            if constexpr (std::is_void_v<result_t>)
+                                (*apply_ptr)();
+                            else
+                                (*apply_ptr)((result_t &&)*result);
+                        }
+                        catch (...)
+                        {
+                            promise->set_exception(std::current_exception());
+                            pending--;
+                            throw;
+                        }
+                        promise->set_value();
+                        pending--;
+                    });
+                }
+                catch (...)
+                {
+                    Fail(std::current_exception());
+                }
+            });
+
+            return ret;
+        }
+
+        template <typename A> Handle Image(std::string file_name, A &&apply) // `apply(Graphics::Image &&)`
+        {
+            return Load([file_name = std::move(file_name)]{return Graphics::Image(Utils::MemoryFile(file_name));}, std::forward<A>(apply));
+        }
+        template <typename A> Handle Sound(std::string file_name, A &&apply) // `apply(Audio::Sound &&)`. `.wav` files are loaded as WAV, everything else as OGG.
+        {
+            return Load([file_name = std::move(file_name)]
+            {
+                Audio::Sound ret;
+                Utils::MemoryFile file(file_name);
+                if (file_name.size() >= 4 && file_name.compare(file_name.size() - 4, 4, ".wav") == 0)
+                    ret.FromWAV(file);
+                else
+                    ret.FromOGG(file);
+                return ret;
+            }, std::forward<A>(apply));
+        }
+
+        void Tick(uint64_t time_budget) // Runs queued `apply()` steps until `time_budget` (in `Timing::Clock()` units) is exceeded. At least one step is run if there are any.
+        {
+            uint64_t begin = Timing::Clock();
+            do
+            {
+                std::function<void()> step;
+                {
+                    std::lock_guard lock(mutex);
+                    if (apply_queue.empty())
+                        return;
+                    step = std::move(apply_queue.front());
+                    apply_queue.pop_front();
+                }
+                step();
+            }
+            while (Timing::Clock() - begin < time_budget);
+        }
+
+        void Finish() // Blocks until all loads are applied. Should be called from the main thread.
+        {
+            while (pending > 0)
+            {
+                {
+                    std::unique_lock lock(mutex);
+                    cv.wait(lock, [&]{return apply_queue.size();});
+                }
+                Tick(-1);
+            }
+        }
+
+        [[nodiscard]] bool Busy() const // Returns 1 if some loads weren't applied yet.
+        {
+            return pending > 0;
+        }
+    };
+
+    /* Loads a set of sounds at once.
+     * The files are read and decoded on a thread pool, then the buffers are created and uploaded in the original order on the calling thread,
+     * since OpenAL calls shouldn't be made from the workers. An upload doesn't wait for the files after it to be loaded.
+     * WAV files that OpenAL can use as is aren't decoded: the workers only read them, and the samples are uploaded straight from the read copy.
+     */
+    class SoundBank
+    {
+      public:
+        struct Entry
+        {
+            std::string file_name;
+            Audio::Buffer buffer;
+            uint64_t decode_time = 0; // In `Timing::Clock()` units.
+            uint64_t upload_time = 0; // Same.
+        };
+
+        struct Stats
+        {
+            int threads = 0;
+            uint64_t decode_time = 0; // Sum of `Entry::decode_time`. Can be larger than `total_time`, since the files are loaded in parallel.
+            uint64_t upload_time = 0; // Sum of `Entry::upload_time`.
+            uint64_t total_time = 0; // Wall time of the whole `Load()`.
+        };
+
+      private:
+        std::vector<Entry> entries;
+        std::unordered_map<std::string, std::size_t> entry_indices; // Maps file names to `entries` indices.
+        Stats stats;
+
+      public:
+        SoundBank() {}
+        SoundBank(const std::vector<std::string> &file_names, int thread_count = 0) // See `Threads::Pool` for the meaning of `thread_count`.
+        {
+            Load(file_names, thread_count);
+        }
+
+        // Reads a list of sounds from a text file: one file name per line, relative to `prefix`. Empty lines and lines starting with `#` are ignored.
+        [[nodiscard]] static SoundBank FromManifest(Utils::MemoryFile manifest, const std::string &prefix = "", int thread_count = 0)
+        {
+            std::vector<std::string> file_names;
+            std::string_view text((const char *)manifest.Data(), manifest.Size());
+            while (text.size())
+            {
+                std::size_t len = std::min(text.find('\n'), text.size());
+                std::string_view line = text.substr(0, len);
+                text.remove_prefix(std::min(len + 1, text.size()));
+
+                while (line.size() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+                    line.remove_suffix(1);
+                while (line.size() && (line.front() == ' ' || line.front() == '\t'))
+                    line.remove_prefix(1);
+                if (line.empty() || line[0] == '#')
+                    continue;
+                file_names.push_back(prefix + std::string(line));
+            }
+            return SoundBank(file_names, thread_count);
+        }
+
+        // `.wav` files are loaded as WAV, everything else as OGG. Replaces the old contents, if any.
+        // If a file can't be loaded, the exception is rethrown after all previous files are uploaded. The bank stays unchanged in that case.
+        void Load(const std::vector<std::string> &file_names, int thread_count = 0)
+        {
+            struct Decoded
+            {
+                Audio::WavFile wav; // Either this or `sound` is used.
+                Audio::Sound sound;
+                uint64_t time = 0;
+            };
+
+            uint64_t begin = Timing::Clock();
+
+            SoundBank new_obj;
+            Threads::Pool pool(thread_count);
+            new_obj.stats.threads = pool.ThreadCount();
+
+            std::vector<std::future<Decoded>> results;
+            results.reserve(file_names.size());
+            for (const std::string &file_name : file_names)
+            {
+                results.push_back(pool.Run([&file_name]
+                {
+                    uint64_t begin = Timing::Clock();
+                    Decoded ret;
+                    Utils::MemoryFile file(file_name); // Not mapped, so that the samples are read here rather than faulted in by the upload on the calling thread.
+                    if (file_name.size() >= 4 && file_name.compare(file_name.size() - 4, 4, ".wav") == 0)
+                    {
+                        ret.wav.Create(file);
+                        if (!ret.wav.Native())
+                        {
+                            ret.sound.FromWAV(file);
+                            ret.wav.Destroy();
+                        }
+                    }
+                    else
+                    {
+                        ret.sound.FromOGG(file);
+                    }
+                    ret.time = Timing::Clock() - begin;
+                    return ret;
+                }));
+            }
+
+            new_obj.entries.reserve(file_names.size());
+            for (std::size_t i = 0; i < file_names.size(); i++)
+            {
+                Decoded decoded = results[i].get(); // If this throws, `pool` finishes the remaining files before the exception leaves this function.
+
+                uint64_t upload_begin = Timing::Clock();
+                Entry &entry = new_obj.entries.emplace_back();
+                entry.file_name = file_names[i];
+                entry.buffer.Create();
+                if (decoded.wav.Exists())
+                    entry.buffer.SetData(decoded.wav);
+                else
+                    entry.buffer.SetData(decoded.sound);
+                entry.decode_time = decoded.time;
+                entry.upload_time = Timing::Clock() - upload_begin;
+
+                new_obj.entry_indices.emplace(entry.file_name, i);
+                new_obj.stats.decode_time += entry.decode_time;
+                new_obj.stats.upload_time += entry.upload_time;
+            }
+
+            new_obj.stats.total_time = Timing::Clock() - begin;
+            *this = std::move(new_obj);
+        }
+
+        [[nodiscard]] std::size_t Size() const
+        {
+            return entries.size();
+        }
+        [[nodiscard]] const std::vector<Entry> &Entries() const // In the same order as the file names passed to `Load()`.
+        {
+            return entries;
+        }
+        [[nodiscard]] const Audio::Buffer *Find(const std::string &file_name) const // Returns null if there is no such file.
+        {
+            auto it = entry_indices.find(file_name);
+            return it == entry_indices.end() ? 0 : &entries[it->second].buffer;
+        }
+        [[nodiscard]] const Audio::Buffer &Get(const std::string &file_name) const
+        {
+            const Audio::Buffer *ret = Find(file_name);
+            if (!ret)
+                Program::Error(Str("Sound `", file_name, "` is not in the sound bank."));
+            return *ret;
+        }
+        [[nodiscard]] const Stats &GetStats() const
+        {
+            return stats;
+        }
+
+        [[nodiscard]] std::string Report() const // A human-readable table of timings, one line per file followed by the totals.
+        {
+            auto Ms = [](uint64_t ticks){return Timing::TicksToSecs(ticks) * 1000;};
+            std::string ret;
+            for (const Entry &entry : entries)
+                ret += Str(entry.file_name, ": decode ", Ms(entry.decode_time), " ms, upload ", Ms(entry.upload_time), " ms\n");
+            ret += Str(entries.size(), " files on ", stats.threads, " threads: total ", Ms(stats.total_time), " ms (decode ", Ms(stats.decode_time), " ms, upload ", Ms(stats.upload_time), " ms)\n");
+            return ret;
+        }
+    };
+}
+
+#endif
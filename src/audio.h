@@ -1,17 +1,31 @@
 #ifndef AUDIO_H_INCLUDED
 #define AUDIO_H_INCLUDED
 
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
+#include <exception>
 #include <fstream>
+#include <functional>
 #include <limits>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <AL/al.h>
 #include <AL/alc.h>
 #include <vorbis/vorbisfile.h>
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 #include "mat.h"
 #include "program.h"
 #include "utils.h"
@@ -156,257 +170,105 @@ namespace Audio
     }
 
 
-    class Sound
+    enum Resampling
     {
-      public:
-        enum Format_t
-        {
-            mono8    = AL_FORMAT_MONO8,
-            mono16   = AL_FORMAT_MONO16,
-            stereo8  = AL_FORMAT_STEREO8,
-            stereo16 = AL_FORMAT_STEREO16,
-        };
-      private:
-        std::vector<uint8_t> data;
-        int freq = 44100;
-        Format_t format = mono8;
-      public:
-        void FromWAV(Utils::MemoryFile file)
-        {
-            if (file.Size() < 44) // 44 is the size of WAV header.
-                throw cant_parse_sound(file.Name(), "The file is too small for a header.");
-
-            const uint8_t *ptr = file.Data();
-
-            if (memcmp(ptr, "RIFF", 4)) throw cant_parse_sound(file.Name(), "No \"RIFF\" label.");
-            ptr += 4;
-
-            uint32_t new_byte_size = Utils::Little((uint32_t &)*ptr) - 36;
-            if (file.Size() < new_byte_size + 44) throw cant_parse_sound(file.Name(), "Unexpected end of file.");
-            ptr += 4;
-
-            if (memcmp(ptr, "WAVE", 4)) throw cant_parse_sound(file.Name(), "No \"WAVE\" label.");
-            ptr += 4;
-
-            if (memcmp(ptr, "fmt ", 4)) throw cant_parse_sound(file.Name(), "No \"fmt \" label.");
-            ptr += 4;
-
-            if (memcmp(ptr, "\x10\0\0", 4)) throw cant_parse_sound(file.Name(), "File structure is too complicated.");
-            ptr += 4;
-
-            if (memcmp(ptr, "\x1", 2)) throw cant_parse_sound(file.Name(), "File is compresssed or uses floating-point samples.");
-            ptr += 2;
-
-            uint16_t channels = Utils::Little((uint16_t &)*ptr);
-            if (channels == 0 || channels > 2) throw cant_parse_sound(file.Name(), "The file must be mono or stereo.");
-            ptr += 2;
-
-            uint32_t new_freq = Utils::Little((uint32_t &)*ptr);
-            ptr += 4;
-
-            ptr += 6; // Skip useless data.
-
-            uint16_t bits_per_sample = Utils::Little((uint16_t &)*ptr);
-            if (bits_per_sample != 8 && bits_per_sample != 16) throw cant_parse_sound(file.Name(), "The file must use 8 or 16 bits per sample.");
-            if (bits_per_sample == 16 && new_byte_size % 2 != 0) throw cant_parse_sound(file.Name(), "The file uses 16 bits per sample, but data size is not a multiple of two.");
-            ptr += 2;
-
-            if (memcmp(ptr, "data", 4)) throw cant_parse_sound(file.Name(), "No \"data\" label.");
-            ptr += 4;
-
-            if (Utils::Little((uint32_t &)*ptr) != new_byte_size) throw cant_parse_sound(file.Name(), "The file contains additional sectons or is corrupted.");
-            ptr += 4;
-
-            Format_t new_format;
-            switch (channels << 16 | bits_per_sample)
-            {
-                default:
-                case 1 << 16 |  8: new_format = mono8;    break;
-                case 1 << 16 | 16: new_format = mono16;   break;
-                case 2 << 16 |  8: new_format = stereo8;  break;
-                case 2 << 16 | 16: new_format = stereo16; break;
-            }
-
-            std::vector<uint8_t> new_data;
-            new_data.reserve(new_byte_size);
-            new_data.insert(new_data.end(), ptr, ptr + new_byte_size);
-            if (Utils::big_endian && bits_per_sample == 16)
-                for (std::size_t i = 0; i < new_data.size() / 2; i++)
-                    Utils::MakeLittle(((uint16_t *)new_data.data())[i]);
+        resample_linear, // 2 taps. Fast, but muffles high frequencies and aliases when downsampling.
+        resample_cubic,  // 4 taps, Catmull-Rom. A good default for upsampling.
+        resample_sinc,   // 16 taps, windowed sinc with a lowpass filter. Use this for downsampling.
+    };
 
-            data = std::move(new_data);
-            freq = new_freq;
-            format = new_format;
-        }
-        void FromOGG(Utils::MemoryFile file, bool load_as_8bit = 0)
+    namespace impl
+    {
+        // Resamples one channel of audio with a polyphase FIR filter.
+        inline std::vector<float> Resample(const std::vector<float> &src, int src_freq, int dst_freq, Resampling quality)
         {
-            (void)OV_CALLBACKS_DEFAULT;
-            (void)OV_CALLBACKS_NOCLOSE;
-            (void)OV_CALLBACKS_STREAMONLY;
-            (void)OV_CALLBACKS_STREAMONLY_NOCLOSE;
-
-            struct Desc
-            {
-                const uint8_t *start, *cur, *end;
-            };
-            Desc desc{file.Data(), file.Data(), file.Data() + file.Size()};
-
-            ov_callbacks callbacks;
-            callbacks.tell_func = [](void *ptr) -> long
-            {
-                Desc &ref = *(Desc *)ptr;
-                return ref.cur - ref.start;
-            };
-            callbacks.seek_func = [](void *ptr, int64_t offset, int mode) -> int
+            constexpr int phases = 1024;
+            const int taps = quality == resample_sinc ? 16 : 4; // Linear interpolation uses 4 taps too, two of them are always zero. Must be a multiple of 4.
+            const float pi = 3.14159265358979323846f;
+
+            // Tap `k` for output position `pos` reads input frame `floor(pos) - taps/2 + 1 + k`.
+            std::vector<float> coeffs(phases * taps);
+            float cutoff = std::min(1.f, float(dst_freq) / src_freq); // Relative to the input Nyquist frequency. Only used for sinc.
+            for (int phase = 0; phase < phases; phase++)
             {
-                Desc &ref = *(Desc *)ptr;
-                switch (mode)
+                float frac = phase / float(phases), sum = 0;
+                for (int k = 0; k < taps; k++)
                 {
-                  case SEEK_SET:
-                    ref.cur = ref.start + offset;
-                    break;
-                  case SEEK_CUR:
-                    ref.cur += offset;
-                    break;
-                  case SEEK_END:
-                    ref.cur = ref.end + offset;
-                    break;
-                  default:
-                    return 1;
+                    float x = k - taps/2 + 1 - frac, ax = std::abs(x), w = 0;
+                    switch (quality)
+                    {
+                      case resample_linear:
+                        w = std::max(0.f, 1 - ax);
+                        break;
+                      case resample_cubic:
+                        w = ax < 1 ? 1.5f*ax*ax*ax - 2.5f*ax*ax + 1 : ax < 2 ? -0.5f*ax*ax*ax + 2.5f*ax*ax - 4*ax + 2 : 0;
+                        break;
+                      case resample_sinc:
+                        {
+                            float t = x / (taps / 2); // Blackman window.
+                            float window = std::abs(t) < 1 ? 0.42f + 0.5f * std::cos(pi * t) + 0.08f * std::cos(2 * pi * t) : 0;
+                            w = (x == 0 ? 1 : std::sin(pi * cutoff * x) / (pi * cutoff * x)) * window;
+                        }
+                        break;
+                    }
+                    coeffs[phase * taps + k] = w;
+                    sum += w;
                 }
-                if (ref.cur < ref.start || ref.cur > ref.end)
-                    return 1;
-                return 0;
-            };
-            callbacks.read_func = [](void *dst, std::size_t sz, std::size_t count, void *ptr) -> std::size_t
-            {
-                Desc &ref = *(Desc *)ptr;
-                if (ref.cur + count * sz > ref.end)
-                    count = (ref.end - ref.cur) / sz;
-                std::copy(ref.cur, ref.cur + count, (uint8_t *)dst);
-                ref.cur += count * sz;
-                return count;
-            };
-            callbacks.close_func = 0;
-
-            OggVorbis_File ogg_file;
-            switch (ov_open_callbacks(&desc, &ogg_file, 0, 0, callbacks))
-            {
-              case 0:
-                break;
-              case OV_EREAD:
-                throw cant_parse_sound(file.Name(), "Unable to read data from the stream.");
-                break;
-              case OV_ENOTVORBIS:
-                throw cant_parse_sound(file.Name(), "This is not vorbis audio.");
-                break;
-              case OV_EVERSION:
-                throw cant_parse_sound(file.Name(), "Vorbis version mismatch.");
-                break;
-              case OV_EBADHEADER:
-                throw cant_parse_sound(file.Name(), "Invalid header.");
-                break;
-              case OV_EFAULT:
-                throw cant_parse_sound(file.Name(), "Internal vorbis error.");
-                break;
-              default:
-                throw cant_parse_sound(file.Name(), "Unknown vorbis error.");
-                break;
-            }
-            // IMPORTANT: Below this line you must do `ov_clear(&ogg_file);` before returning or throwing anything.
-
-            vorbis_info *info = ov_info(&ogg_file, -1);
-            uint64_t samples = ov_pcm_total(&ogg_file, -1);
-            if (samples > 0xffffffffu)
-            {
-                ov_clear(&ogg_file);
-                throw cant_parse_sound(file.Name(), "The file is too big.");
-            }
-
-            Sound new_obj;
-
-            try
-            {
-                switch (info->channels << 16 | load_as_8bit)
+                if (sum != 0)
                 {
-                  case 1 << 16 | 1:
-                    new_obj.FromMemory(mono8, info->rate, samples);
-                    break;
-                  case 1 << 16 | 0:
-                    new_obj.FromMemory(mono16, info->rate, samples);
-                    break;
-                  case 2 << 16 | 1:
-                    new_obj.FromMemory(stereo8, info->rate, samples);
-                    break;
-                  case 2 << 16 | 0:
-                    new_obj.FromMemory(stereo16, info->rate, samples);
-                    break;
-                  default:
-                    throw cant_parse_sound(file.Name(), Str("The file must be mono or stereo, but this one has ", info->channels, " channels."));
-                    break;
+                    for (int k = 0; k < taps; k++)
+                        coeffs[phase * taps + k] /= sum; // Unity gain at DC.
                 }
             }
-            catch (...)
-            {
-                ov_clear(&ogg_file);
-                throw;
-            }
 
-            uint32_t buf_len = new_obj.Bytes();
-            char *buf = (char *)new_obj.Data();
+            // Zero padding, so the taps never go out of bounds.
+            std::vector<float> padded(src.size() + taps);
+            std::copy(src.begin(), src.end(), padded.begin() + taps/2 - 1);
 
-            int current_bitstream = -1;
-            while (1)
+            std::size_t dst_size = (uint64_t(src.size()) * dst_freq + src_freq - 1) / src_freq;
+            std::vector<float> dst(dst_size);
+            for (std::size_t i = 0; i < dst_size; i++)
             {
-                if (buf_len == 0)
-                    break;
-                int bitstream;
-                long val = ov_read(&ogg_file, buf, buf_len, Utils::big_endian, load_as_8bit ? 1 : 2, !load_as_8bit, &bitstream);
-                if (val == 0)
-                {
-                    ov_clear(&ogg_file);
-                    throw cant_parse_sound(file.Name(), "Unexpected end of stream.");
-                }
-                if (bitstream != current_bitstream)
-                {
-                    current_bitstream = bitstream;
-                    vorbis_info *local_info = ov_info(&ogg_file, bitstream);
-                    if (local_info->channels != info->channels)
-                    {
-                        ov_clear(&ogg_file);
-                        throw cant_parse_sound(file.Name(), Str("The amount of channels has changed from ", info->channels, " to ", local_info->channels, ". Dynamic amount of channels is not supported."));
-                    }
-                    if (local_info->rate != info->rate)
-                    {
-                        ov_clear(&ogg_file);
-                        throw cant_parse_sound(file.Name(), Str("The sampling rate has changed from ", info->rate, " to ", local_info->rate, ". Dynamic sampling rate is not supported."));
-                    }
-                }
-                switch (val)
-                {
-                  case OV_HOLE:
-                    ov_clear(&ogg_file);
-                    throw cant_parse_sound(file.Name(), "The file is corrupted.");
-                    break;
-                  case OV_EBADLINK:
-                    ov_clear(&ogg_file);
-                    throw cant_parse_sound(file.Name(), "Bad link.");
-                    break;
-                  case OV_EINVAL:
-                    ov_clear(&ogg_file);
-                    throw cant_parse_sound(file.Name(), "Invalid header.");
-                    break;
-                  default:
-                    buf += val;
-                    buf_len -= val;
-                    break;
-                }
+                uint64_t num = uint64_t(i) * src_freq;
+                std::size_t index = num / dst_freq;
+                const float *in = padded.data() + index, *c = coeffs.data() + (num % dst_freq) * phases / dst_freq * taps;
+
+                #ifdef __SSE2__
+                __m128 acc = _mm_setzero_ps();
+                for (int k = 0; k < taps; k += 4)
+                    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(in + k), _mm_loadu_ps(c + k)));
+                acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+                acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+                dst[i] = _mm_cvtss_f32(acc);
+                #else
+                float acc = 0;
+                for (int k = 0; k < taps; k++)
+                    acc += in[k] * c[k];
+                dst[i] = acc;
+                #endif
             }
+            return dst;
+        }
+    }
 
-            ov_clear(&ogg_file);
 
-            *this = std::move(new_obj);
-        }
+    class Sound
+    {
+      public:
+        enum Format_t
+        {
+            mono8    = AL_FORMAT_MONO8,
+            mono16   = AL_FORMAT_MONO16,
+            stereo8  = AL_FORMAT_STEREO8,
+            stereo16 = AL_FORMAT_STEREO16,
+        };
+      private:
+        std::vector<uint8_t> data;
+        int freq = 44100;
+        Format_t format = mono8;
+      public:
+        void FromWAV(Utils::MemoryFile file); // Defined below `WavFile`.
+        void FromOGG(Utils::MemoryFile file, bool load_as_8bit = 0); // Defined below `OggDecoder`.
         void FromWAV_Mono(Utils::MemoryFile file)
         {
             FromWAV(file);
@@ -485,6 +347,69 @@ namespace Audio
         [[nodiscard]] static Sound OGG_Mono  (Utils::MemoryFile file, bool load_as_8bit = 0) {Sound ret; ret.FromOGG_Mono  (file, load_as_8bit); return ret;}
         [[nodiscard]] static Sound OGG_Stereo(Utils::MemoryFile file, bool load_as_8bit = 0) {Sound ret; ret.FromOGG_Stereo(file, load_as_8bit); return ret;}
 
+        [[nodiscard]] Sound Converted(Format_t new_format, int new_freq, Resampling quality = resample_cubic) const // Changes the format, resampling if needed.
+        {
+            int channels = Stereo() ? 2 : 1, new_channels = (new_format == stereo8 || new_format == stereo16) ? 2 : 1;
+            std::size_t frames = Samples();
+
+            // Deinterleave and convert to floats.
+            std::vector<float> planes[2];
+            for (int ch = 0; ch < channels; ch++)
+            {
+                planes[ch].resize(frames);
+                for (std::size_t i = 0; i < frames; i++)
+                {
+                    std::size_t index = i * channels + ch;
+                    if (Bits8())
+                    {
+                        planes[ch][i] = (int(data[index]) - 128) / 128.f;
+                    }
+                    else
+                    {
+                        int16_t value;
+                        std::memcpy(&value, data.data() + index * 2, 2);
+                        planes[ch][i] = value / 32768.f;
+                    }
+                }
+            }
+
+            if (channels == 2 && new_channels == 1)
+            {
+                for (std::size_t i = 0; i < frames; i++)
+                    planes[0][i] = (planes[0][i] + planes[1][i]) / 2;
+                planes[1] = {};
+                channels = 1;
+            }
+
+            if (new_freq != freq)
+            {
+                for (int ch = 0; ch < channels; ch++)
+                    planes[ch] = impl::Resample(planes[ch], freq, new_freq, quality);
+                frames = planes[0].size();
+            }
+
+            Sound ret;
+            ret.FromMemory(new_format, new_freq, frames);
+            for (std::size_t i = 0; i < frames; i++)
+            {
+                for (int ch = 0; ch < new_channels; ch++)
+                {
+                    float value = planes[channels == 1 ? 0 : ch][i];
+                    std::size_t index = i * new_channels + ch;
+                    if (ret.Bits8())
+                    {
+                        ret.data[index] = std::clamp<long>(std::lround(value * 128) + 128, 0, 255);
+                    }
+                    else
+                    {
+                        int16_t sample = std::clamp<long>(std::lround(value * 32768), -32768, 32767);
+                        std::memcpy(ret.data.data() + index * 2, &sample, 2);
+                    }
+                }
+            }
+            return ret;
+        }
+
         void FromMemory(Format_t new_format, int new_freq, uint32_t new_sample_count, const uint8_t *new_data = 0)
         {
             format = new_format;
@@ -494,7 +419,7 @@ namespace Audio
                 std::copy(new_data, new_data + data.size(), (uint8_t *)data.data());
         }
 
-        int BytesPerSample() const
+        [[nodiscard]] static int BytesPerSample(Format_t format)
         {
             switch (format)
             {
@@ -505,6 +430,10 @@ namespace Audio
                 case stereo16: return 4;
             }
         }
+        int BytesPerSample() const
+        {
+            return BytesPerSample(format);
+        }
 
         void Clear()
         {
@@ -553,78 +482,598 @@ namespace Audio
     };
 
 
-    class Source;
-
-    class Buffer
+    class WavFile // A parsed WAV file. The samples are referenced from the file rather than copied, so with a mapped file nothing is loaded until it's used.
     {
-        friend class Source;
+        Utils::MemoryFile file;
+        const uint8_t *samples = 0;
+        std::size_t bytes = 0;
+        int channels = 0, freq = 0, bits = 0;
+        bool is_float = 0;
 
-        class HandleFuncs
+        static uint16_t Read16(const uint8_t *ptr) {return ptr[0] | ptr[1] << 8;}
+        static uint32_t Read32(const uint8_t *ptr) {return uint32_t(Read16(ptr)) | uint32_t(Read16(ptr + 2)) << 16;}
+
+      public:
+        WavFile() {}
+        WavFile(Utils::MemoryFile file)
         {
-            template <typename> friend class ::Utils::Handle;
-            static ALuint Create()
-            {
-                DebugAssert("Attempt to use a null AL context.", Context::Exists());
-                ALuint value;
-                alGenBuffers(1, &value);
-                return value;
-            }
-            static void Destroy(ALuint value)
-            {
-                alDeleteBuffers(1, &value);
-            }
-            static void Error()
+            Create(file);
+        }
+
+        void Create(Utils::MemoryFile new_file)
+        {
+            const std::string &name = new_file.Name();
+            const uint8_t *ptr = new_file.Data(), *end = ptr + new_file.Size();
+
+            if (new_file.Size() < 12) throw cant_parse_sound(name, "The file is too small for a header.");
+            if (memcmp(ptr, "RIFF", 4)) throw cant_parse_sound(name, "No \"RIFF\" label.");
+            if (memcmp(ptr + 8, "WAVE", 4)) throw cant_parse_sound(name, "No \"WAVE\" label.");
+            if (uint32_t riff_size = Read32(ptr + 4); riff_size >= 4 && riff_size < std::size_t(end - ptr - 8))
+                end = ptr + 8 + riff_size; // Some files have junk after the RIFF chunk. If the size is too large, the file was probably truncated, so we use as much as there is.
+            ptr += 12;
+
+            WavFile new_obj;
+            new_obj.file = new_file;
+            uint16_t tag = 0;
+            bool have_format = 0, have_data = 0;
+
+            // Walk the chunks. Everything except the format and the data (`LIST`, `fact`, `cue `, and so on) is skipped.
+            while (end - ptr >= 8)
             {
-                throw cant_create_al_resource("Buffer");
+                const uint8_t *body = ptr + 8;
+                std::size_t size = Read32(ptr + 4), avail = end - body;
+
+                if (!memcmp(ptr, "fmt ", 4))
+                {
+                    if (size < 16 || size > avail) throw cant_parse_sound(name, "The format chunk is too small.");
+                    tag = Read16(body);
+                    new_obj.channels = Read16(body + 2);
+                    new_obj.freq = Read32(body + 4);
+                    new_obj.bits = Read16(body + 14);
+                    if (tag == 0xfffe && size >= 40) // WAVE_FORMAT_EXTENSIBLE, the actual format is in the first two bytes of the subformat GUID.
+                        tag = Read16(body + 24);
+                    have_format = 1;
+                }
+                else if (!memcmp(ptr, "data", 4))
+                {
+                    if (size > avail)
+                        size = avail; // Truncated file, or a writer that never filled in the size.
+                    new_obj.samples = body;
+                    new_obj.bytes = size;
+                    have_data = 1;
+                }
+
+                if (size > avail)
+                    break;
+                ptr = body + size + (size & 1); // Chunks are padded to even sizes.
             }
-        };
-        using Handle_t = Utils::Handle<HandleFuncs>;
-        Handle_t handle;
 
-      public:
-        Buffer(decltype(nullptr)) : handle(Handle_t::params_t{}) {}
-        Buffer() {}
-        Buffer(const Sound &sound) : Buffer(nullptr) {SetData(sound);}
+            if (!have_format) throw cant_parse_sound(name, "No \"fmt \" chunk.");
+            if (!have_data) throw cant_parse_sound(name, "No \"data\" chunk.");
+            if (tag != 1 && tag != 3) throw cant_parse_sound(name, "The file is compressed.");
+            new_obj.is_float = tag == 3;
+            if (new_obj.channels != 1 && new_obj.channels != 2) throw cant_parse_sound(name, "The file must be mono or stereo.");
+            if (new_obj.freq <= 0) throw cant_parse_sound(name, "Invalid sampling rate.");
+            if (new_obj.is_float ? new_obj.bits != 32 && new_obj.bits != 64 : new_obj.bits != 8 && new_obj.bits != 16 && new_obj.bits != 24 && new_obj.bits != 32)
+                throw cant_parse_sound(name, "Unsupported number of bits per sample.");
 
-        void Create()
-        {
-            handle.create({});
+            new_obj.bytes -= new_obj.bytes % new_obj.FrameBytes(); // Drop an incomplete frame at the end, if any.
+
+            *this = std::move(new_obj);
         }
         void Destroy()
         {
-            handle.destroy();
+            *this = {};
         }
         bool Exists() const
         {
-            return bool(handle);
+            return file.Exists();
         }
 
-        void SetData(Sound::Format_t format, int freq, int bytes, const uint8_t *ptr = 0)
+        [[nodiscard]] int Channels() const
         {
-            DebugAssert("Attempt to use a null audio buffer.", *handle);
-            alBufferData(*handle, (ALenum)format, ptr, bytes, freq);
+            return channels;
         }
-        void SetData(const Sound &data)
+        [[nodiscard]] int Frequency() const
         {
-            SetData(data.Format(), data.Frequency(), data.Bytes(), data.Data());
+            return freq;
         }
-
-        Source operator()(float volume = 1, float pitch = 1) const; // Creates a temporary source to play the sound.
-    };
-
-
-    class Source
-    {
-        inline static float default_ref_dist = 1,
-                            default_rolloff_fac = 1,
-                            default_max_dist = std::numeric_limits<float>::infinity();
-
-        class Object
+        [[nodiscard]] int BitsPerSample() const // As stored in the file.
         {
-            ALuint handle;
-          public:
-            Object()
-            {
+            return bits;
+        }
+        [[nodiscard]] bool IsFloat() const
+        {
+            return is_float;
+        }
+        [[nodiscard]] int FrameBytes() const // Bytes per sample for all channels, as stored in the file.
+        {
+            return channels * bits / 8;
+        }
+        [[nodiscard]] std::size_t Samples() const
+        {
+            return bytes / FrameBytes();
+        }
+
+        [[nodiscard]] Sound::Format_t Format() const // The format after decoding. 8-bit files stay 8-bit, everything else becomes 16-bit.
+        {
+            if (bits == 8 && !is_float)
+                return channels == 2 ? Sound::stereo8 : Sound::mono8;
+            else
+                return channels == 2 ? Sound::stereo16 : Sound::mono16;
+        }
+        [[nodiscard]] bool Native() const // Returns 1 if OpenAL can use the samples as is, without `Decode()`.
+        {
+            return !is_float && (bits == 8 || (bits == 16 && Utils::little_endian));
+        }
+        [[nodiscard]] const uint8_t *Data() const // The samples as stored in the file.
+        {
+            return samples;
+        }
+        [[nodiscard]] std::size_t Bytes() const
+        {
+            return bytes;
+        }
+        [[nodiscard]] std::size_t DecodedBytes() const
+        {
+            return Samples() * Sound::BytesPerSample(Format());
+        }
+
+        void Decode(uint8_t *dst) const // Writes `DecodedBytes()` bytes of samples in `Format()` to `dst`.
+        {
+            std::size_t count = Samples() * channels;
+            const uint8_t *src = samples;
+
+            auto Clamp16 = [](double value) -> int16_t
+            {
+                return std::clamp<long>(std::lround(value * 32768), -32768, 32767);
+            };
+
+            if (is_float && bits == 32)
+            {
+                for (std::size_t i = 0; i < count; i++, src += 4)
+                {
+                    uint32_t raw = Read32(src);
+                    float value;
+                    std::memcpy(&value, &raw, 4);
+                    int16_t sample = Clamp16(value);
+                    std::memcpy(dst + i * 2, &sample, 2);
+                }
+            }
+            else if (is_float)
+            {
+                for (std::size_t i = 0; i < count; i++, src += 8)
+                {
+                    uint64_t raw = Read32(src) | uint64_t(Read32(src + 4)) << 32;
+                    double value;
+                    std::memcpy(&value, &raw, 8);
+                    int16_t sample = Clamp16(value);
+                    std::memcpy(dst + i * 2, &sample, 2);
+                }
+            }
+            else if (bits == 8)
+            {
+                std::memcpy(dst, src, count);
+            }
+            else if (bits == 16)
+            {
+                Reflection::Bytes::copy_fixing_order<int16_t>(dst, src, count);
+            }
+            else
+            {
+                // 24 and 32 bits. Only the high 16 bits of each sample are kept.
+                int step = bits / 8;
+                for (std::size_t i = 0; i < count; i++, src += step)
+                {
+                    int16_t sample = src[step-2] | src[step-1] << 8;
+                    std::memcpy(dst + i * 2, &sample, 2);
+                }
+            }
+        }
+    };
+
+    inline void Sound::FromWAV(Utils::MemoryFile file)
+    {
+        WavFile wav(file);
+        if (wav.Samples() > 0xffffffffu)
+            throw cant_parse_sound(file.Name(), "The file is too big.");
+
+        std::vector<uint8_t> new_data;
+        if (wav.Native())
+        {
+            new_data.assign(wav.Data(), wav.Data() + wav.Bytes()); // Avoid zeroing the memory first.
+        }
+        else
+        {
+            new_data.resize(wav.DecodedBytes());
+            wav.Decode(new_data.data());
+        }
+
+        data = std::move(new_data);
+        freq = wav.Frequency();
+        format = wav.Format();
+    }
+
+
+    class OggDecoder // Decodes an OGG file in pieces. The compressed file stays in memory, but the decoded data doesn't have to.
+    {
+        struct Data
+        {
+            Utils::MemoryFile file;
+            const uint8_t *cur = 0;
+            OggVorbis_File ogg_file;
+            bool opened = 0;
+            bool load_as_8bit = 0;
+            int channels = 0;
+            long rate = 0;
+            int current_bitstream = -1;
+
+            Data() {}
+            Data(const Data &) = delete;
+            Data &operator=(const Data &) = delete;
+            ~Data()
+            {
+                if (opened)
+                    ov_clear(&ogg_file);
+            }
+        };
+
+        std::unique_ptr<Data> data; // Vorbis callbacks store a pointer to this, so it shouldn't move.
+
+      public:
+        OggDecoder() {}
+        OggDecoder(Utils::MemoryFile file, bool load_as_8bit = 0)
+        {
+            Create(file, load_as_8bit);
+        }
+
+        void Create(Utils::MemoryFile file, bool load_as_8bit = 0)
+        {
+            (void)OV_CALLBACKS_DEFAULT;
+            (void)OV_CALLBACKS_NOCLOSE;
+            (void)OV_CALLBACKS_STREAMONLY;
+            (void)OV_CALLBACKS_STREAMONLY_NOCLOSE;
+
+            auto new_data = std::make_unique<Data>();
+            new_data->file = file;
+            new_data->cur = file.Data();
+            new_data->load_as_8bit = load_as_8bit;
+
+            ov_callbacks callbacks;
+            callbacks.tell_func = [](void *ptr) -> long
+            {
+                Data &ref = *(Data *)ptr;
+                return ref.cur - ref.file.Data();
+            };
+            callbacks.seek_func = [](void *ptr, int64_t offset, int mode) -> int
+            {
+                Data &ref = *(Data *)ptr;
+                const uint8_t *start = ref.file.Data(), *end = ref.file.Data() + ref.file.Size(), *new_cur;
+                switch (mode)
+                {
+                  case SEEK_SET:
+                    new_cur = start + offset;
+                    break;
+                  case SEEK_CUR:
+                    new_cur = ref.cur + offset;
+                    break;
+                  case SEEK_END:
+                    new_cur = end + offset;
+                    break;
+                  default:
+                    return 1;
+                }
+                if (new_cur < start || new_cur > end)
+                    return 1;
+                ref.cur = new_cur;
+                return 0;
+            };
+            callbacks.read_func = [](void *dst, std::size_t sz, std::size_t count, void *ptr) -> std::size_t
+            {
+                Data &ref = *(Data *)ptr;
+                const uint8_t *end = ref.file.Data() + ref.file.Size();
+                if (std::size_t(end - ref.cur) < count * sz)
+                    count = (end - ref.cur) / sz;
+                std::copy(ref.cur, ref.cur + count * sz, (uint8_t *)dst);
+                ref.cur += count * sz;
+                return count;
+            };
+            callbacks.close_func = 0;
+
+            switch (ov_open_callbacks(new_data.get(), &new_data->ogg_file, 0, 0, callbacks))
+            {
+              case 0:
+                break;
+              case OV_EREAD:
+                throw cant_parse_sound(file.Name(), "Unable to read data from the stream.");
+                break;
+              case OV_ENOTVORBIS:
+                throw cant_parse_sound(file.Name(), "This is not vorbis audio.");
+                break;
+              case OV_EVERSION:
+                throw cant_parse_sound(file.Name(), "Vorbis version mismatch.");
+                break;
+              case OV_EBADHEADER:
+                throw cant_parse_sound(file.Name(), "Invalid header.");
+                break;
+              case OV_EFAULT:
+                throw cant_parse_sound(file.Name(), "Internal vorbis error.");
+                break;
+              default:
+                throw cant_parse_sound(file.Name(), "Unknown vorbis error.");
+                break;
+            }
+            new_data->opened = 1;
+
+            vorbis_info *info = ov_info(&new_data->ogg_file, -1);
+            if (info->channels != 1 && info->channels != 2)
+                throw cant_parse_sound(file.Name(), Str("The file must be mono or stereo, but this one has ", info->channels, " channels."));
+            new_data->channels = info->channels;
+            new_data->rate = info->rate;
+
+            data = std::move(new_data);
+        }
+        void Destroy()
+        {
+            data.reset();
+        }
+        [[nodiscard]] bool Exists() const
+        {
+            return bool(data);
+        }
+
+        [[nodiscard]] Sound::Format_t Format() const
+        {
+            DebugAssert("Attempt to use a null OGG decoder.", data);
+            switch (data->channels << 16 | data->load_as_8bit)
+            {
+                default:
+                case 1 << 16 | 1: return Sound::mono8;
+                case 1 << 16 | 0: return Sound::mono16;
+                case 2 << 16 | 1: return Sound::stereo8;
+                case 2 << 16 | 0: return Sound::stereo16;
+            }
+        }
+        [[nodiscard]] int Frequency() const
+        {
+            DebugAssert("Attempt to use a null OGG decoder.", data);
+            return data->rate;
+        }
+        [[nodiscard]] uint64_t Samples() const // Total amount of samples, as stored in the file.
+        {
+            DebugAssert("Attempt to use a null OGG decoder.", data);
+            return ov_pcm_total(&data->ogg_file, -1);
+        }
+
+        std::size_t Read(uint8_t *dst, std::size_t len) // Returns the amount of bytes written, which is less than `len` only at the end of the stream.
+        {
+            DebugAssert("Attempt to use a null OGG decoder.", data);
+            const std::string &name = data->file.Name();
+
+            std::size_t ret = 0;
+            while (ret < len)
+            {
+                int bitstream;
+                long val = ov_read(&data->ogg_file, (char *)dst + ret, std::min(len - ret, std::size_t(std::numeric_limits<int>::max())),
+                                   Utils::big_endian, data->load_as_8bit ? 1 : 2, !data->load_as_8bit, &bitstream);
+                if (val == 0)
+                    break;
+                switch (val)
+                {
+                  case OV_HOLE:
+                    throw cant_parse_sound(name, "The file is corrupted.");
+                    break;
+                  case OV_EBADLINK:
+                    throw cant_parse_sound(name, "Bad link.");
+                    break;
+                  case OV_EINVAL:
+                    throw cant_parse_sound(name, "Invalid header.");
+                    break;
+                }
+                if (bitstream != data->current_bitstream)
+                {
+                    data->current_bitstream = bitstream;
+                    vorbis_info *local_info = ov_info(&data->ogg_file, bitstream);
+                    if (local_info->channels != data->channels)
+                        throw cant_parse_sound(name, Str("The amount of channels has changed from ", data->channels, " to ", local_info->channels, ". Dynamic amount of channels is not supported."));
+                    if (local_info->rate != data->rate)
+                        throw cant_parse_sound(name, Str("The sampling rate has changed from ", data->rate, " to ", local_info->rate, ". Dynamic sampling rate is not supported."));
+                }
+                ret += val;
+            }
+            return ret;
+        }
+
+        void Rewind() // Goes back to the beginning of the stream.
+        {
+            DebugAssert("Attempt to use a null OGG decoder.", data);
+            if (ov_pcm_seek(&data->ogg_file, 0))
+                throw cant_parse_sound(data->file.Name(), "Unable to seek.");
+        }
+    };
+
+    inline void Sound::FromOGG(Utils::MemoryFile file, bool load_as_8bit)
+    {
+        OggDecoder decoder(file, load_as_8bit);
+
+        uint64_t samples = decoder.Samples();
+        if (samples > 0xffffffffu)
+            throw cant_parse_sound(file.Name(), "The file is too big.");
+
+        Sound new_obj;
+        new_obj.FromMemory(decoder.Format(), decoder.Frequency(), samples);
+        if (decoder.Read(new_obj.Data(), new_obj.Bytes()) != new_obj.Bytes())
+            throw cant_parse_sound(file.Name(), "Unexpected end of stream.");
+
+        *this = std::move(new_obj);
+    }
+
+    // Loads a WAV or OGG file (`.wav` files are loaded as WAV, everything else as OGG), converted to `format` and `freq`.
+    // The result is cached as raw PCM in `<file_name>.pcm`. Next time it's loaded from there without decoding or resampling, unless the source file changes.
+    [[nodiscard]] inline Sound LoadConverted(const std::string &file_name, Sound::Format_t format, int freq, Resampling quality = resample_cubic)
+    {
+        static constexpr uint32_t cache_version_magic = 1; // This should be changed when the cache structure changes.
+
+        Utils::MemoryFile file(file_name);
+        uint32_t key[] = {cache_version_magic, uint32_t(crc32(0, file.Data(), file.Size())), uint32_t(file.Size()), uint32_t(format), uint32_t(freq), uint32_t(quality)};
+        std::string cache_name = file_name + ".pcm";
+        int bytes_per_sample = Sound::BytesPerSample(format);
+
+        try
+        {
+            // Not mapped: another thread or process may replace the cache meanwhile. A copy that was cut short fails the checks below.
+            Utils::MemoryFile cache(cache_name);
+            const uint8_t *begin = cache.Data(), *end = cache.Data() + cache.Size();
+            bool ok = 1;
+            for (uint32_t expected : key)
+            {
+                uint32_t value;
+                begin = Reflection::from_bytes<uint32_t>(value, begin, end);
+                if (!begin || value != expected)
+                {
+                    ok = 0;
+                    break;
+                }
+            }
+            if (ok && (end - begin) % bytes_per_sample == 0)
+            {
+                Sound ret;
+                ret.FromMemory(format, freq, (end - begin) / bytes_per_sample);
+                if (ret.Bits8())
+                    std::memcpy(ret.Data(), begin, ret.Bytes());
+                else
+                    Reflection::Bytes::copy_fixing_order<int16_t>(ret.Data(), begin, ret.Bytes() / 2);
+                return ret;
+            }
+        }
+        catch (decltype(Utils::file_input_error("","")) &e) {} // No cache yet.
+
+        Sound ret;
+        if (file_name.size() >= 4 && file_name.compare(file_name.size() - 4, 4, ".wav") == 0)
+            ret.FromWAV(file);
+        else
+            ret.FromOGG(file);
+        if (ret.Format() != format || int(ret.Frequency()) != freq)
+            ret = ret.Converted(format, freq, quality);
+
+        std::size_t len = sizeof key + ret.Bytes();
+        auto buf = std::make_unique<uint8_t[]>(len);
+        uint8_t *ptr = buf.get();
+        for (uint32_t value : key)
+            ptr = Reflection::to_bytes<uint32_t>(value, ptr);
+        if (ret.Bits8())
+            std::memcpy(ptr, ret.Data(), ret.Bytes());
+        else
+            Reflection::Bytes::copy_fixing_order<int16_t>(ptr, ret.Data(), ret.Bytes() / 2);
+
+        // The cache is written to a temporary file and then renamed, so that readers don't see it half-written.
+        // The temporary name includes the thread id, in case several threads convert the same file at once.
+        // If any of this fails, the file will be converted again next time, which is fine.
+        std::string temp_name = Str(cache_name, ".", std::hash<std::thread::id>{}(std::this_thread::get_id()), ".tmp");
+        if (Utils::WriteToFile(temp_name, buf.get(), len))
+        {
+            std::remove(cache_name.c_str()); // `std::rename()` fails on Windows if the target exists.
+            if (std::rename(temp_name.c_str(), cache_name.c_str()))
+                std::remove(temp_name.c_str());
+        }
+
+        return ret;
+    }
+
+
+    class Source;
+    class Stream;
+    class VoicePool;
+
+    class Buffer
+    {
+        friend class Source;
+        friend class Stream;
+        friend class VoicePool;
+
+        class HandleFuncs
+        {
+            template <typename> friend class ::Utils::Handle;
+            static ALuint Create()
+            {
+                DebugAssert("Attempt to use a null AL context.", Context::Exists());
+                ALuint value;
+                alGenBuffers(1, &value);
+                return value;
+            }
+            static void Destroy(ALuint value)
+            {
+                alDeleteBuffers(1, &value);
+            }
+            static void Error()
+            {
+                throw cant_create_al_resource("Buffer");
+            }
+        };
+        using Handle_t = Utils::Handle<HandleFuncs>;
+        Handle_t handle;
+
+      public:
+        Buffer(decltype(nullptr)) : handle(Handle_t::params_t{}) {}
+        Buffer() {}
+        Buffer(const Sound &sound) : Buffer(nullptr) {SetData(sound);}
+        Buffer(const WavFile &wav) : Buffer(nullptr) {SetData(wav);}
+
+        void Create()
+        {
+            handle.create({});
+        }
+        void Destroy()
+        {
+            handle.destroy();
+        }
+        bool Exists() const
+        {
+            return bool(handle);
+        }
+
+        void SetData(Sound::Format_t format, int freq, int bytes, const uint8_t *ptr = 0)
+        {
+            DebugAssert("Attempt to use a null audio buffer.", *handle);
+            alBufferData(*handle, (ALenum)format, ptr, bytes, freq);
+        }
+        void SetData(const Sound &data)
+        {
+            SetData(data.Format(), data.Frequency(), data.Bytes(), data.Data());
+        }
+        void SetData(const WavFile &wav) // Uploads straight from the file if the samples don't need converting.
+        {
+            if (wav.Native())
+            {
+                SetData(wav.Format(), wav.Frequency(), wav.Bytes(), wav.Data());
+            }
+            else
+            {
+                std::vector<uint8_t> decoded(wav.DecodedBytes());
+                wav.Decode(decoded.data());
+                SetData(wav.Format(), wav.Frequency(), decoded.size(), decoded.data());
+            }
+        }
+
+        Source operator()(float volume = 1, float pitch = 1) const; // Creates a temporary source to play the sound.
+    };
+
+
+    class Source
+    {
+        friend class Stream;
+        friend class VoicePool;
+
+        inline static float default_ref_dist = 1,
+                            default_rolloff_fac = 1,
+                            default_max_dist = std::numeric_limits<float>::infinity();
+
+        class Object
+        {
+            ALuint handle;
+          public:
+            Object()
+            {
                 DebugAssert("Attempt to use a null AL context.", Context::Exists());
                 alGenSources(1, &handle);
                 if (!handle) handle = -1;
@@ -691,12 +1140,18 @@ namespace Audio
         }
 
 
-        void Create(const Buffer &buffer)
+        void Create() // Creates a source without a buffer.
         {
             if (Exists())
                 return;
             object = std::make_shared<Object>();
             temp = 0;
+        }
+        void Create(const Buffer &buffer)
+        {
+            if (Exists())
+                return;
+            Create();
             alSourcei(*object, AL_BUFFER, *buffer.handle);
         }
         void Destroy()
@@ -837,6 +1292,497 @@ namespace Audio
         src.temporary().volume(volume).pitch(pitch);
         return src;
     }
+
+
+    class VoicePool // A fixed set of OpenAL sources for one-shot sounds. Playing a sound doesn't create sources or allocate memory.
+    {
+      public:
+        enum StealMode {steal_quietest, steal_oldest};
+
+        struct Params
+        {
+            float volume = 1, pitch = 1;
+            fvec3 pos = fvec3(0);
+            bool relative = 1; // If this is set, `pos` is relative to the listener. The default is a non-positional sound.
+            int priority = 0; // A voice can only be stolen by a sound with the same or higher priority.
+        };
+
+        struct Stats
+        {
+            int active = 0; // Updated by `Update()` and `Play()`.
+            uint64_t played = 0, stolen = 0, rejected = 0, culled = 0; // `rejected` means that there were no free voices and nothing could be stolen. `culled` means that the sound was too quiet.
+        };
+
+        class Voice // A handle for a playing sound. It becomes invalid when the sound stops or its voice is stolen.
+        {
+            friend class VoicePool;
+            uint32_t index = -1, generation = 0;
+          public:
+            Voice() {}
+            [[nodiscard]] explicit operator bool() const {return index != uint32_t(-1);}
+        };
+
+      private:
+        struct VoiceData
+        {
+            ALuint source = 0;
+            uint32_t generation = 0;
+            bool active = 0;
+            int priority = 0;
+            float audibility = 0; // Volume with distance attenuation, at the moment the sound was started.
+            uint64_t start = 0; // Value of `play_counter`.
+        };
+
+        std::vector<VoiceData> voices;
+        fvec3 listener_pos = fvec3(0);
+        float cull_threshold = 0.001;
+        StealMode steal_mode = steal_quietest;
+        uint64_t play_counter = 0;
+        Stats stats;
+
+        float Audibility(const Params &params) const // Matches the default `AL_INVERSE_DISTANCE_CLAMPED` model.
+        {
+            float dist = (params.relative ? params.pos : params.pos - listener_pos).len();
+            float ref = Source::default_ref_dist, max = Source::default_max_dist;
+            dist = std::clamp(dist, ref, std::max(ref, max));
+            return params.volume * ref / (ref + Source::default_rolloff_fac * (dist - ref));
+        }
+
+        void Release(VoiceData &voice)
+        {
+            voice.active = 0;
+            voice.generation++;
+            stats.active--;
+        }
+
+        VoiceData *Find(Voice voice)
+        {
+            if (voice.index >= voices.size() || !voices[voice.index].active || voices[voice.index].generation != voice.generation)
+                return 0;
+            return &voices[voice.index];
+        }
+
+        VoiceData *FindFree()
+        {
+            for (auto &voice : voices)
+                if (!voice.active)
+                    return &voice;
+            return 0;
+        }
+
+      public:
+        VoicePool() {}
+        VoicePool(int size)
+        {
+            Create(size);
+        }
+
+        VoicePool(const VoicePool &) = delete;
+        VoicePool &operator=(const VoicePool &) = delete;
+
+        ~VoicePool()
+        {
+            Destroy();
+        }
+
+        void Create(int size) // The buffers that are played should outlive the pool.
+        {
+            DebugAssert("Attempt to use a null AL context.", Context::Exists());
+            Destroy();
+            voices.reserve(size);
+            for (int i = 0; i < size; i++)
+            {
+                ALuint source = 0;
+                alGenSources(1, &source);
+                if (!source)
+                    break; // Drivers often have a hard limit on sources, so we use as many as we can get. See `Size()`.
+                alSourcef(source, AL_REFERENCE_DISTANCE, Source::default_ref_dist);
+                alSourcef(source, AL_ROLLOFF_FACTOR,     Source::default_rolloff_fac);
+                alSourcef(source, AL_MAX_DISTANCE,       Source::default_max_dist);
+                voices.emplace_back().source = source;
+            }
+        }
+        void Destroy()
+        {
+            for (auto &voice : voices)
+            {
+                alSourceStop(voice.source);
+                alDeleteSources(1, &voice.source);
+            }
+            voices = {};
+            stats.active = 0;
+        }
+
+        void SetListenerPos(fvec3 pos) // The pool doesn't query the listener position from OpenAL, so set it here as well. It's only used for culling and stealing.
+        {
+            listener_pos = pos;
+        }
+        void SetCullThreshold(float audibility) // Sounds quieter than this (after distance attenuation) aren't played.
+        {
+            cull_threshold = audibility;
+        }
+        void SetStealMode(StealMode mode)
+        {
+            steal_mode = mode;
+        }
+
+        void Update() // Frees the voices that have finished playing. Call it regularly, e.g. once per frame.
+        {
+            for (auto &voice : voices)
+            {
+                if (!voice.active)
+                    continue;
+                ALint state;
+                alGetSourcei(voice.source, AL_SOURCE_STATE, &state);
+                if (state != AL_PLAYING)
+                    Release(voice);
+            }
+        }
+
+        Voice Play(const Buffer &buffer, Params params) // Returns a null handle if the sound was culled or rejected.
+        {
+            DebugAssert("Attempt to use a null audio buffer.", buffer.Exists());
+
+            float audibility = Audibility(params);
+            if (audibility < cull_threshold)
+            {
+                stats.culled++;
+                return {};
+            }
+
+            VoiceData *voice = FindFree();
+            if (!voice)
+            {
+                Update();
+                voice = FindFree();
+            }
+            if (!voice)
+            {
+                // Steal a voice with the lowest priority, then the quietest or the oldest one.
+                for (auto &it : voices)
+                {
+                    if (it.priority > params.priority)
+                        continue;
+                    if (steal_mode == steal_quietest && it.priority == params.priority && it.audibility > audibility)
+                        continue; // Not replacing a louder sound of the same priority.
+                    if (!voice || it.priority < voice->priority ||
+                        (it.priority == voice->priority && (steal_mode == steal_quietest ? it.audibility < voice->audibility : it.start < voice->start)))
+                        voice = &it;
+                }
+                if (!voice)
+                {
+                    stats.rejected++;
+                    return {};
+                }
+                alSourceStop(voice->source);
+                Release(*voice);
+                stats.stolen++;
+            }
+
+            alSourcei(voice->source, AL_BUFFER, *buffer.handle);
+            alSourcef(voice->source, AL_GAIN, params.volume);
+            alSourcef(voice->source, AL_PITCH, params.pitch);
+            alSourcefv(voice->source, AL_POSITION, params.pos.as_array());
+            alSourcei(voice->source, AL_SOURCE_RELATIVE, params.relative);
+            alSourcePlay(voice->source);
+
+            voice->active = 1;
+            voice->priority = params.priority;
+            voice->audibility = audibility;
+            voice->start = play_counter++;
+            stats.active++;
+            stats.played++;
+
+            Voice ret;
+            ret.index = voice - voices.data();
+            ret.generation = voice->generation;
+            return ret;
+        }
+
+        void Stop(Voice voice)
+        {
+            if (VoiceData *data = Find(voice))
+            {
+                alSourceStop(data->source);
+                Release(*data);
+            }
+        }
+        [[nodiscard]] bool IsPlaying(Voice voice) // Can return 1 for a finished sound until the next `Update()`.
+        {
+            return Find(voice);
+        }
+        void SetPos(Voice voice, fvec3 pos)
+        {
+            if (VoiceData *data = Find(voice))
+                alSourcefv(data->source, AL_POSITION, pos.as_array());
+        }
+        void SetVolume(Voice voice, float volume)
+        {
+            if (VoiceData *data = Find(voice))
+                alSourcef(data->source, AL_GAIN, volume);
+        }
+
+        [[nodiscard]] int Size() const
+        {
+            return voices.size();
+        }
+        [[nodiscard]] const Stats &GetStats() const
+        {
+            return stats;
+        }
+        void ResetStats() // Resets the counters, but not `active`.
+        {
+            stats = {stats.active};
+        }
+    };
+
+
+    class Stream // Plays a long sound without decoding all of it at once. The data is decoded in chunks on a background thread.
+    {
+      public:
+        // Runs on the background thread. Should fill `dst` and return the amount of bytes written.
+        // Returning less than `len` means that the stream has ended. Exceptions are rethrown from `Update()`.
+        using provider_t = std::function<std::size_t(uint8_t *dst, std::size_t len)>;
+
+      private:
+        struct Data
+        {
+            provider_t provider;
+            Sound::Format_t format;
+            int freq;
+
+            // Decoded chunks, used as a ring. The background thread fills them, and `Update()` moves them to the buffers.
+            std::vector<std::vector<uint8_t>> chunks;
+            std::vector<std::size_t> chunk_sizes;
+            std::size_t first_ready = 0, ready_count = 0;
+            bool decoding_finished = 0, stop = 0;
+            std::exception_ptr error;
+
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::thread thread;
+
+            std::vector<Buffer> buffers;
+            std::vector<ALuint> free_buffers; // Buffers that aren't queued.
+            Source source; // This must be below `buffers`, so that it's destroyed before them.
+            bool playing = 0;
+
+            Data() {}
+            Data(const Data &) = delete;
+            Data &operator=(const Data &) = delete;
+            ~Data()
+            {
+                {
+                    std::lock_guard lock(mutex);
+                    stop = 1;
+                }
+                cv.notify_all();
+                if (thread.joinable())
+                    thread.join();
+
+                if (source.Exists() && *source.object != ALuint(-1))
+                {
+                    alSourceStop(*source.object);
+                    alSourcei(*source.object, AL_BUFFER, 0); // Unqueues all buffers, so they can be deleted.
+                }
+            }
+
+            void Decode() // The background thread runs this.
+            {
+                std::size_t next = 0;
+                while (1)
+                {
+                    {
+                        std::unique_lock lock(mutex);
+                        cv.wait(lock, [&]{return stop || ready_count < chunks.size();});
+                        if (stop)
+                            return;
+                    }
+
+                    // This chunk isn't ready, so nobody else touches it.
+                    std::size_t size;
+                    try
+                    {
+                        size = provider(chunks[next].data(), chunks[next].size());
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard lock(mutex);
+                        error = std::current_exception();
+                        decoding_finished = 1;
+                        return;
+                    }
+
+                    std::lock_guard lock(mutex);
+                    chunk_sizes[next] = size;
+                    ready_count++;
+                    if (size < chunks[next].size())
+                    {
+                        decoding_finished = 1;
+                        return;
+                    }
+                    next = (next + 1) % chunks.size();
+                }
+            }
+        };
+
+        std::unique_ptr<Data> data; // The background thread stores a pointer to this, so it shouldn't move.
+
+      public:
+        Stream() {}
+        Stream(provider_t provider, Sound::Format_t format, int freq, int buffer_count = 4, int chunk_ms = 250)
+        {
+            Create(std::move(provider), format, freq, buffer_count, chunk_ms);
+        }
+
+        // Memory usage is roughly `buffer_count * 2` chunks, and the latency of `Update()` must be less than `(buffer_count - 1) * chunk_ms`.
+        void Create(provider_t provider, Sound::Format_t format, int freq, int buffer_count = 4, int chunk_ms = 250)
+        {
+            DebugAssert("Audio stream: Invalid parameters.", buffer_count >= 2 && chunk_ms > 0 && freq > 0);
+
+            int bytes_per_sample = Sound::BytesPerSample(format);
+            std::size_t chunk_bytes = std::max<std::size_t>(1, int64_t(freq) * chunk_ms / 1000) * bytes_per_sample;
+
+            auto new_data = std::make_unique<Data>();
+            new_data->provider = std::move(provider);
+            new_data->format = format;
+            new_data->freq = freq;
+            new_data->chunks.assign(buffer_count, std::vector<uint8_t>(chunk_bytes));
+            new_data->chunk_sizes.resize(buffer_count);
+            new_data->source.Create();
+            for (int i = 0; i < buffer_count; i++)
+            {
+                new_data->buffers.emplace_back(nullptr);
+                new_data->free_buffers.push_back(*new_data->buffers.back().handle);
+            }
+            new_data->thread = std::thread([d = new_data.get()]{d->Decode();});
+
+            data = std::move(new_data);
+        }
+        void Destroy()
+        {
+            data.reset();
+        }
+        [[nodiscard]] bool Exists() const
+        {
+            return bool(data);
+        }
+
+        // Streams an OGG file. Decoding state is only a few kilobytes, plus the compressed file.
+        [[nodiscard]] static Stream OGG(Utils::MemoryFile file, bool loop = 0, bool load_as_8bit = 0, int buffer_count = 4, int chunk_ms = 250)
+        {
+            auto decoder = std::make_shared<OggDecoder>(file, load_as_8bit); // `std::function` needs copyable targets.
+            Sound::Format_t format = decoder->Format();
+            int freq = decoder->Frequency();
+            return Stream([decoder, loop](uint8_t *dst, std::size_t len) -> std::size_t
+            {
+                std::size_t ret = decoder->Read(dst, len);
+                while (loop && ret < len)
+                {
+                    decoder->Rewind();
+                    std::size_t bytes = decoder->Read(dst + ret, len - ret);
+                    if (bytes == 0)
+                        break; // The stream is empty.
+                    ret += bytes;
+                }
+                return ret;
+            }, format, freq, buffer_count, chunk_ms);
+        }
+
+        void Update() // Call this regularly on the main thread, e.g. once per frame. Queues the decoded chunks and restarts playback after underruns.
+        {
+            if (!data || *data->source.object == ALuint(-1))
+                return;
+            ALuint source = *data->source.object;
+
+            { // Reclaim the played buffers
+                ALint processed = 0;
+                alGetSourcei(source, AL_BUFFERS_PROCESSED, &processed);
+                while (processed-- > 0)
+                {
+                    ALuint buffer;
+                    alSourceUnqueueBuffers(source, 1, &buffer);
+                    data->free_buffers.push_back(buffer);
+                }
+            }
+
+            while (data->free_buffers.size() > 0)
+            {
+                std::size_t index, size;
+                {
+                    std::lock_guard lock(data->mutex);
+                    if (data->ready_count == 0)
+                    {
+                        if (data->error)
+                            std::rethrow_exception(std::exchange(data->error, nullptr));
+                        break;
+                    }
+                    index = data->first_ready;
+                    size = data->chunk_sizes[index];
+                }
+
+                // The decoder doesn't touch ready chunks, so this can be done without the lock.
+                if (size > 0)
+                {
+                    ALuint buffer = data->free_buffers.back();
+                    data->free_buffers.pop_back();
+                    alBufferData(buffer, (ALenum)data->format, data->chunks[index].data(), size, data->freq);
+                    alSourceQueueBuffers(source, 1, &buffer);
+                }
+
+                {
+                    std::lock_guard lock(data->mutex);
+                    data->first_ready = (data->first_ready + 1) % data->chunks.size();
+                    data->ready_count--;
+                }
+                data->cv.notify_all();
+            }
+
+            if (data->playing)
+            {
+                ALint state, queued;
+                alGetSourcei(source, AL_SOURCE_STATE, &state);
+                alGetSourcei(source, AL_BUFFERS_QUEUED, &queued);
+                if (state != AL_PLAYING && queued > 0)
+                    alSourcePlay(source); // Either we're starting or resuming, or the decoder couldn't keep up.
+            }
+        }
+
+        void Play() // Playback actually starts in `Update()`, once the first chunk is decoded.
+        {
+            DebugAssert("Attempt to use a null audio stream.", data);
+            data->playing = 1;
+        }
+        void Pause()
+        {
+            DebugAssert("Attempt to use a null audio stream.", data);
+            data->playing = 0;
+            if (*data->source.object != ALuint(-1))
+                alSourcePause(*data->source.object); // Not stopping, since that would mark all queued buffers as processed.
+        }
+
+        [[nodiscard]] bool Finished() const // Returns 1 if the whole stream was played.
+        {
+            DebugAssert("Attempt to use a null audio stream.", data);
+            {
+                std::lock_guard lock(data->mutex);
+                if (!data->decoding_finished || data->ready_count > 0)
+                    return 0;
+            }
+            if (*data->source.object == ALuint(-1))
+                return 1;
+            ALint queued, processed;
+            alGetSourcei(*data->source.object, AL_BUFFERS_QUEUED, &queued);
+            alGetSourcei(*data->source.object, AL_BUFFERS_PROCESSED, &processed);
+            return queued == processed;
+        }
+
+        [[nodiscard]] Source &GetSource() // Use this to change volume, position and so on. Don't attach buffers to it.
+        {
+            DebugAssert("Attempt to use a null audio stream.", data);
+            return data->source;
+        }
+    };
 }
 
 #endif
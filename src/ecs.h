@@ -0,0 +1,678 @@
+#ifndef ECS_H_INCLUDED
+#define ECS_H_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "program.h"
+#include "strings.h"
+#include "threads.h"
+
+/* Entity-component system, for large numbers of similar objects. Unique objects should stay in `Scene`.
+ * Entities with the same set of components share an archetype. An archetype stores its components in fixed-size chunks,
+ * with a separate array for each component, so queries read memory sequentially.
+ * Structural changes (creating and destroying entities, adding and removing components) are not allowed during queries.
+ * Use a `CommandBuffer` to record them and apply them later.
+ */
+
+namespace Ecs
+{
+    using component_id_t = uint32_t;
+
+    struct Entity // Stays valid until the entity is destroyed. After that, the index can be reused with a different generation.
+    {
+        uint32_t index = -1;
+        uint32_t generation = 0;
+
+        explicit operator bool() const
+        {
+            return index != uint32_t(-1);
+        }
+        bool operator==(const Entity &other) const
+        {
+            return index == other.index && generation == other.generation;
+        }
+        bool operator!=(const Entity &other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    namespace impl
+    {
+        struct ComponentInfo
+        {
+            component_id_t id = 0;
+            std::size_t size = 0, align = 0;
+            void (*move)(void *dst, void *src) = 0; // Move-constructs `dst` from `src`, then destroys `src`.
+            void (*destroy)(void *ptr) = 0;
+            const char *name = 0;
+        };
+
+        // Component types are registered when first used, possibly from several threads at once.
+        // Archetypes keep their own copies of the infos, so the registry is only touched when registering types and creating archetypes.
+        inline std::mutex &RegistryMutex()
+        {
+            static std::mutex ret;
+            return ret;
+        }
+        inline std::vector<ComponentInfo> &Registry()
+        {
+            static std::vector<ComponentInfo> ret;
+            return ret;
+        }
+        inline ComponentInfo GetComponentInfo(component_id_t id)
+        {
+            std::lock_guard lock(RegistryMutex());
+            return Registry()[id];
+        }
+    }
+
+    template <typename T> component_id_t ComponentId()
+    {
+        static_assert(std::is_same_v<T, std::decay_t<T>>, "Component types must not be cv-qualified or references.");
+        static_assert(std::is_nothrow_move_constructible_v<T>, "Components must be nothrow move constructible, since they move when the archetype storage changes.");
+        static_assert(alignof(T) <= alignof(std::max_align_t), "Overaligned components are not supported.");
+
+        static const component_id_t ret = []
+        {
+            std::lock_guard lock(impl::RegistryMutex());
+            auto &registry = impl::Registry();
+            impl::ComponentInfo info;
+            info.id = registry.size();
+            info.size = sizeof(T);
+            info.align = alignof(T);
+            info.move = [](void *dst, void *src)
+            {
+                new(dst) T((T &&)*(T *)src);
+                ((T *)src)->~T();
+            };
+            info.destroy = [](void *ptr)
+            {
+                ((T *)ptr)->~T();
+            };
+            info.name = typeid(T).name();
+            registry.push_back(info);
+            return info.id;
+        }();
+        return ret;
+    }
+
+
+    class World;
+
+    class Archetype
+    {
+        friend class World;
+
+        static constexpr std::size_t chunk_bytes = 16384;
+
+        std::vector<impl::ComponentInfo> components; // Sorted by id.
+        std::vector<std::size_t> offsets; // Offsets of the component arrays in a chunk.
+        std::size_t capacity = 0; // Entities per chunk.
+        std::size_t count = 0; // Rows are dense. Row `i` is in chunk `i / capacity`.
+        std::vector<std::unique_ptr<std::max_align_t[]>> chunks;
+        std::vector<Entity> entities; // One per row.
+
+      public:
+        Archetype(std::vector<impl::ComponentInfo> new_components) : components(std::move(new_components))
+        {
+            std::size_t row_bytes = 0, padding = 0;
+            for (const auto &info : components)
+            {
+                row_bytes += info.size;
+                padding += info.align;
+            }
+            capacity = row_bytes ? std::max<std::size_t>(1, (chunk_bytes - padding) / row_bytes) : chunk_bytes;
+
+            std::size_t offset = 0;
+            for (const auto &info : components)
+            {
+                offset = (offset + info.align - 1) / info.align * info.align;
+                offsets.push_back(offset);
+                offset += info.size * capacity;
+            }
+        }
+
+        Archetype(const Archetype &) = delete;
+        Archetype &operator=(const Archetype &) = delete;
+
+        ~Archetype()
+        {
+            for (std::size_t row = 0; row < count; row++)
+            {
+                for (std::size_t i = 0; i < components.size(); i++)
+                    components[i].destroy(At(i, row));
+            }
+        }
+
+        [[nodiscard]] int Column(component_id_t id) const // Returns -1 if there is no such component.
+        {
+            auto it = std::lower_bound(components.begin(), components.end(), id, [](const impl::ComponentInfo &a, component_id_t b){return a.id < b;});
+            return it != components.end() && it->id == id ? it - components.begin() : -1;
+        }
+        [[nodiscard]] bool Has(component_id_t id) const
+        {
+            return Column(id) != -1;
+        }
+
+        [[nodiscard]] std::size_t Size() const
+        {
+            return count;
+        }
+        [[nodiscard]] std::size_t ChunkCount() const
+        {
+            return (count + capacity - 1) / capacity;
+        }
+        [[nodiscard]] std::size_t ChunkSize(std::size_t chunk) const
+        {
+            return std::min(capacity, count - chunk * capacity);
+        }
+        [[nodiscard]] void *ChunkColumn(std::size_t chunk, int column) const // Returns the array of `column` in `chunk`.
+        {
+            return (char *)chunks[chunk].get() + offsets[column];
+        }
+        [[nodiscard]] const Entity *ChunkEntities(std::size_t chunk) const
+        {
+            return entities.data() + chunk * capacity;
+        }
+
+      private:
+        [[nodiscard]] void *At(int column, std::size_t row) const
+        {
+            return (char *)ChunkColumn(row / capacity, column) + components[column].size * (row % capacity);
+        }
+
+        std::size_t AddRow(Entity entity) // The components of the new row are not constructed.
+        {
+            if (count == chunks.size() * capacity)
+            {
+                std::size_t bytes = components.size() ? offsets.back() + components.back().size * capacity : 0;
+                chunks.push_back(std::make_unique<std::max_align_t[]>((bytes + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t)));
+            }
+            entities.push_back(entity);
+            return count++;
+        }
+
+        // Fills the row with the last row, and returns the entity that was moved (or a null entity if the row was the last one).
+        // The components of `row` must already be destroyed or moved out.
+        Entity RemoveRow(std::size_t row)
+        {
+            Entity moved;
+            std::size_t last = count - 1;
+            if (row != last)
+            {
+                for (std::size_t i = 0; i < components.size(); i++)
+                    components[i].move(At(i, row), At(i, last));
+                entities[row] = entities[last];
+                moved = entities[row];
+            }
+            entities.pop_back();
+            count--;
+            if (chunks.size() > ChunkCount() + 1)
+                chunks.pop_back(); // Keep one spare chunk, so that adding and removing one entity at a chunk boundary doesn't allocate every time.
+            return moved;
+        }
+    };
+
+
+    /* Records structural changes to apply later with `World::Apply()`. Several threads can record to the same buffer.
+     * Commands that refer to entities that are dead by the time they are applied do nothing.
+     */
+    class CommandBuffer
+    {
+        friend class World;
+
+        std::mutex mutex;
+        std::vector<std::function<void(World &)>> commands;
+
+        void Push(std::function<void(World &)> func)
+        {
+            std::lock_guard lock(mutex);
+            commands.push_back(std::move(func));
+        }
+
+      public:
+        CommandBuffer() {}
+
+        template <typename ...C> void Create(C &&... components);
+        void Destroy(Entity entity);
+        template <typename C> void Add(Entity entity, C &&component);
+        template <typename C> void Remove(Entity entity);
+
+        [[nodiscard]] bool Empty()
+        {
+            std::lock_guard lock(mutex);
+            return commands.empty();
+        }
+    };
+
+
+    class World
+    {
+        struct Location
+        {
+            Archetype *archetype = 0; // Null for free indices.
+            std::size_t row = 0;
+            uint32_t generation = 0;
+        };
+
+        std::vector<Location> locations; // Indexed by `Entity::index`.
+        std::vector<uint32_t> free_indices;
+        std::vector<std::unique_ptr<Archetype>> archetypes;
+        std::map<std::vector<component_id_t>, Archetype *> archetypes_by_signature;
+        std::size_t entity_count = 0;
+        std::atomic_int active_queries{0}; // Queries can run in parallel, see `Systems`.
+
+        void AssertNotIterating() const
+        {
+            DebugAssert("Structural changes to an ECS world are not allowed during queries. Use a `CommandBuffer`.", active_queries == 0);
+        }
+
+        Archetype &GetArchetype(std::vector<component_id_t> ids) // `ids` must be sorted and unique.
+        {
+            auto it = archetypes_by_signature.find(ids);
+            if (it != archetypes_by_signature.end())
+                return *it->second;
+
+            std::vector<impl::ComponentInfo> infos;
+            infos.reserve(ids.size());
+            for (component_id_t id : ids)
+                infos.push_back(impl::GetComponentInfo(id));
+            Archetype &ret = *archetypes.emplace_back(std::make_unique<Archetype>(std::move(infos)));
+            archetypes_by_signature.emplace(std::move(ids), &ret);
+            return ret;
+        }
+
+        static std::vector<component_id_t> Signature(const Archetype &archetype)
+        {
+            std::vector<component_id_t> ret;
+            ret.reserve(archetype.components.size());
+            for (const auto &info : archetype.components)
+                ret.push_back(info.id);
+            return ret;
+        }
+
+        Location &GetLocation(Entity entity)
+        {
+            if (!Alive(entity))
+                Program::Error("Attempt to use a dead ECS entity.");
+            return locations[entity.index];
+        }
+
+        // Moves the entity to `target`. Components that `target` doesn't have are destroyed. The new components are left unconstructed, and the new row is returned.
+        std::size_t MoveEntity(Entity entity, Archetype &target)
+        {
+            Location &loc = locations[entity.index];
+            Archetype &source = *loc.archetype;
+            std::size_t new_row = target.AddRow(entity);
+            for (std::size_t i = 0; i < source.components.size(); i++)
+            {
+                int column = target.Column(source.components[i].id);
+                if (column == -1)
+                    source.components[i].destroy(source.At(i, loc.row));
+                else
+                    source.components[i].move(target.At(column, new_row), source.At(i, loc.row));
+            }
+            if (Entity moved = source.RemoveRow(loc.row))
+                locations[moved.index].row = loc.row;
+            loc.archetype = &target;
+            loc.row = new_row;
+            return new_row;
+        }
+
+        template <typename ...C, typename F, std::size_t ...I> static void EachInChunk(const Archetype &archetype, std::size_t chunk, const int *columns, F &func, std::index_sequence<I...>)
+        {
+            std::size_t size = archetype.ChunkSize(chunk);
+            std::tuple<C *...> arrays{(C *)archetype.ChunkColumn(chunk, columns[I])...};
+            const Entity *entities = archetype.ChunkEntities(chunk);
+            for (std::size_t i = 0; i < size; i++)
+            {
+                if constexpr (std::is_invocable_v<F &, Entity, C &...>)
+                    func(entities[i], std::get<I>(arrays)[i]...);
+                else
+                    func(std::get<I>(arrays)[i]...);
+            }
+        }
+
+      public:
+        World() {}
+
+        World(const World &) = delete;
+        World &operator=(const World &) = delete;
+
+        ~World()
+        {
+            AssertNotIterating();
+        }
+
+        template <typename ...C> Entity Create(C &&... components)
+        {
+            AssertNotIterating();
+
+            std::vector<component_id_t> ids = {ComponentId<std::decay_t<C>>()...};
+            std::sort(ids.begin(), ids.end());
+            if (std::adjacent_find(ids.begin(), ids.end()) != ids.end())
+                Program::Error("Duplicate components specified for an ECS entity.");
+            Archetype &archetype = GetArchetype(std::move(ids));
+
+            Entity ret;
+            if (free_indices.size())
+            {
+                ret.index = free_indices.back();
+                free_indices.pop_back();
+            }
+            else
+            {
+                ret.index = locations.size();
+                locations.emplace_back();
+            }
+            Location &loc = locations[ret.index];
+            ret.generation = loc.generation;
+
+            loc.archetype = &archetype;
+            loc.row = archetype.AddRow(ret);
+            (new(archetype.At(archetype.Column(ComponentId<std::decay_t<C>>()), loc.row)) std::decay_t<C>(std::forward<C>(components)), ...);
+            entity_count++;
+            return ret;
+        }
+
+        void Destroy(Entity entity)
+        {
+            AssertNotIterating();
+
+            Location &loc = GetLocation(entity);
+            Archetype &archetype = *loc.archetype;
+            for (std::size_t i = 0; i < archetype.components.size(); i++)
+                archetype.components[i].destroy(archetype.At(i, loc.row));
+            if (Entity moved = archetype.RemoveRow(loc.row))
+                locations[moved.index].row = loc.row;
+
+            loc.archetype = 0;
+            loc.generation++;
+            free_indices.push_back(entity.index);
+            entity_count--;
+        }
+
+        [[nodiscard]] bool Alive(Entity entity) const
+        {
+            return entity.index < locations.size() && locations[entity.index].archetype && locations[entity.index].generation == entity.generation;
+        }
+
+        template <typename C> C &Add(Entity entity, C &&component) // If the entity already has this component, it's replaced.
+        {
+            using T = std::decay_t<C>;
+            AssertNotIterating();
+
+            if (T *existing = TryGet<T>(entity))
+            {
+                *existing = std::forward<C>(component);
+                return *existing;
+            }
+
+            std::vector<component_id_t> ids = Signature(*GetLocation(entity).archetype);
+            ids.insert(std::upper_bound(ids.begin(), ids.end(), ComponentId<T>()), ComponentId<T>());
+            Archetype &target = GetArchetype(std::move(ids));
+            std::size_t row = MoveEntity(entity, target);
+            return *new(target.At(target.Column(ComponentId<T>()), row)) T(std::forward<C>(component));
+        }
+
+        template <typename C> void Remove(Entity entity) // Does nothing if the entity doesn't have this component.
+        {
+            AssertNotIterating();
+
+            Location &loc = GetLocation(entity);
+            if (!loc.archetype->Has(ComponentId<C>()))
+                return;
+            std::vector<component_id_t> ids = Signature(*loc.archetype);
+            ids.erase(std::find(ids.begin(), ids.end(), ComponentId<C>()));
+            MoveEntity(entity, GetArchetype(std::move(ids)));
+        }
+
+        template <typename C> [[nodiscard]] C *TryGet(Entity entity) // Returns null if the entity doesn't have this component.
+        {
+            Location &loc = GetLocation(entity);
+            int column = loc.archetype->Column(ComponentId<std::remove_const_t<C>>());
+            return column == -1 ? 0 : (C *)loc.archetype->At(column, loc.row);
+        }
+        template <typename C> [[nodiscard]] C &Get(Entity entity)
+        {
+            C *ret = TryGet<C>(entity);
+            if (!ret)
+                Program::Error(Str("ECS entity has no component with type `", typeid(C).name(), "`."));
+            return *ret;
+        }
+        template <typename C> [[nodiscard]] bool Has(Entity entity)
+        {
+            return TryGet<C>(entity);
+        }
+
+        // Calls `func(C &...)` or `func(Entity, C &...)` for each entity that has all of the components.
+        // Use const component types for read-only access, this matters for `Systems`.
+        template <typename ...C, typename F> void Each(F &&func)
+        {
+            static_assert(sizeof...(C) > 0, "At least one component type is required.");
+
+            active_queries++;
+            struct Guard
+            {
+                std::atomic_int &ref;
+                ~Guard() {ref--;}
+            } guard{active_queries};
+
+            const component_id_t ids[] = {ComponentId<std::remove_const_t<C>>()...};
+            for (const auto &archetype : archetypes)
+            {
+                if (archetype->count == 0)
+                    continue;
+                int columns[sizeof...(C)];
+                bool matches = 1;
+                for (std::size_t i = 0; i < sizeof...(C); i++)
+                {
+                    columns[i] = archetype->Column(ids[i]);
+                    if (columns[i] == -1)
+                    {
+                        matches = 0;
+                        break;
+                    }
+                }
+                if (!matches)
+                    continue;
+
+                for (std::size_t chunk = 0; chunk < archetype->ChunkCount(); chunk++)
+                    EachInChunk<C...>(*archetype, chunk, columns, func, std::index_sequence_for<C...>{});
+            }
+        }
+
+        void Apply(CommandBuffer &buffer) // Applies the recorded commands in order, then clears the buffer.
+        {
+            AssertNotIterating();
+
+            std::vector<std::function<void(World &)>> commands;
+            {
+                std::lock_guard lock(buffer.mutex);
+                std::swap(commands, buffer.commands);
+            }
+            for (auto &command : commands)
+                command(*this);
+        }
+
+        [[nodiscard]] std::size_t Size() const
+        {
+            return entity_count;
+        }
+        [[nodiscard]] const std::vector<std::unique_ptr<Archetype>> &Archetypes() const
+        {
+            return archetypes;
+        }
+    };
+
+
+    template <typename ...C> void CommandBuffer::Create(C &&... components)
+    {
+        // `std::function` needs copyable targets, so the components are stored in a shared pointer.
+        auto ptr = std::make_shared<std::tuple<std::decay_t<C>...>>(std::forward<C>(components)...);
+        Push([ptr](World &world)
+        {
+            std::apply([&](auto &... components){world.Create(std::move(components)...);}, *ptr);
+        });
+    }
+    inline void CommandBuffer::Destroy(Entity entity)
+    {
+        Push([entity](World &world)
+        {
+            if (world.Alive(entity))
+                world.Destroy(entity);
+        });
+    }
+    template <typename C> void CommandBuffer::Add(Entity entity, C &&component)
+    {
+        auto ptr = std::make_shared<std::decay_t<C>>(std::forward<C>(component));
+        Push([entity, ptr](World &world)
+        {
+            if (world.Alive(entity))
+                world.Add(entity, std::move(*ptr));
+        });
+    }
+    template <typename C> void CommandBuffer::Remove(Entity entity)
+    {
+        Push([entity](World &world)
+        {
+            if (world.Alive(entity))
+                world.Remove<C>(entity);
+        });
+    }
+
+
+    /* A list of systems that run in order.
+     * Each system declares which components it reads (const types) and writes (non-const types).
+     * Consecutive systems that don't write anything the others read or write are grouped and run in parallel on a thread pool.
+     * Structural changes should go to the provided `CommandBuffer`, which is applied after all systems finish.
+     */
+    class Systems
+    {
+        using func_t = std::function<void(World &, CommandBuffer &)>;
+
+        struct System
+        {
+            func_t func;
+            std::vector<component_id_t> reads, writes;
+        };
+
+        std::vector<System> systems;
+        std::vector<std::size_t> batch_starts; // Systems from `batch_starts[i]` to `batch_starts[i+1]` (or the end) run in parallel.
+        CommandBuffer commands;
+
+        static bool Overlap(const std::vector<component_id_t> &a, const std::vector<component_id_t> &b)
+        {
+            return std::any_of(a.begin(), a.end(), [&](component_id_t id){return std::find(b.begin(), b.end(), id) != b.end();});
+        }
+        bool Conflicts(const System &a, const System &b) const
+        {
+            return Overlap(a.writes, b.writes) || Overlap(a.writes, b.reads) || Overlap(a.reads, b.writes);
+        }
+
+      public:
+        Systems() {}
+
+        // Adds a system. `C...` are all components that `func` accesses, const for read-only access.
+        template <typename ...C> void Add(func_t func)
+        {
+            System system;
+            system.func = std::move(func);
+            ((std::is_const_v<C> ? system.reads : system.writes).push_back(ComponentId<std::remove_const_t<C>>()), ...);
+
+            bool new_batch = batch_starts.empty();
+            for (std::size_t i = new_batch ? systems.size() : batch_starts.back(); i < systems.size(); i++)
+            {
+                if (Conflicts(system, systems[i]))
+                {
+                    new_batch = 1;
+                    break;
+                }
+            }
+            if (new_batch)
+                batch_starts.push_back(systems.size());
+            systems.push_back(std::move(system));
+        }
+        // Adds a system that calls `func(C &...)` or `func(Entity, C &...)` for each matching entity.
+        template <typename ...C, typename F> void AddEach(F &&func)
+        {
+            Add<C...>([func = std::forward<F>(func)](World &world, CommandBuffer &)
+            {
+                world.Each<C...>(func);
+            });
+        }
+
+        [[nodiscard]] std::size_t Size() const
+        {
+            return systems.size();
+        }
+        [[nodiscard]] std::size_t BatchCount() const
+        {
+            return batch_starts.size();
+        }
+
+        void Run(World &world, Threads::Pool *pool = 0) // If `pool` is null, everything runs on the calling thread.
+        {
+            for (std::size_t batch = 0; batch < batch_starts.size(); batch++)
+            {
+                std::size_t begin = batch_starts[batch], end = batch + 1 < batch_starts.size() ? batch_starts[batch + 1] : systems.size();
+
+                if (!pool || !pool->Exists() || end - begin == 1)
+                {
+                    for (std::size_t i = begin; i < end; i++)
+                        systems[i].func(world, commands);
+                    continue;
+                }
+
+                std::vector<std::future<void>> futures;
+                for (std::size_t i = begin + 1; i < end; i++)
+                    futures.push_back(pool->Run([&, i]{systems[i].func(world, commands);}));
+
+                // The first system of the batch runs on this thread. Every future is waited for before anything is rethrown, because they reference `world`.
+                std::exception_ptr error;
+                try
+                {
+                    systems[begin].func(world, commands);
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+                for (auto &future : futures)
+                {
+                    try
+                    {
+                        future.get();
+                    }
+                    catch (...)
+                    {
+                        if (!error)
+                            error = std::current_exception();
+                    }
+                }
+                if (error)
+                    std::rethrow_exception(error);
+            }
+
+            world.Apply(commands);
+        }
+    };
+}
+
+#endif
@@ -1,9 +1,13 @@
+#include "assets.h"
 #include "audio.h"
+#include "ecs.h"
 #include "events.h"
 #include "exceptions.h"
+#include "file_watcher.h"
 #include "graphics.h"
 #include "input.h"
 #include "mat.h"
+#include "mixer.h"
 #include "preprocessor.h"
 #include "program.h"
 #include "random.h"
@@ -11,6 +15,7 @@
 #include "renderers2d.h"
 #include "scenes.h"
 #include "strings.h"
+#include "threads.h"
 #include "timing.h"
 #include "template_utils.h"
 #include "ui.h"
@@ -0,0 +1,226 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+#  include <sys/inotify.h>
+#  include <unistd.h>
+#  define FILE_WATCHER_INOTIFY
+#endif
+
+#include "timing.h"
+
+namespace Utils
+{
+    struct FileWatcher::Data
+    {
+        struct Entry
+        {
+            std::string file_name, base_name; // `base_name` is the file name without the directory.
+            std::vector<std::pair<uint64_t, std::function<void()>>> callbacks; // Handle ids and callbacks.
+
+            int64_t mod_time = 0, size = -1; // For polling. -1 size means that the file doesn't exist.
+            int watch_descriptor = -1; // For inotify.
+
+            bool pending = 0; // The file has changed, but the settle time hasn't passed yet.
+            uint64_t last_change = 0;
+        };
+
+        std::vector<Entry> entries;
+        uint64_t next_id = 1; // For handles. 0 means a null handle.
+
+        uint64_t settle_time = Timing::Tpms() * 200, poll_interval = Timing::Tpms() * 250;
+        uint64_t last_poll = 0;
+
+        int inotify_fd = -1; // If this is -1, polling is used for all files.
+
+        Data()
+        {
+            #ifdef FILE_WATCHER_INOTIFY
+            inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            #endif
+        }
+        Data(const Data &) = delete;
+        Data &operator=(const Data &) = delete;
+        ~Data()
+        {
+            #ifdef FILE_WATCHER_INOTIFY
+            if (inotify_fd != -1)
+                close(inotify_fd);
+            #endif
+        }
+
+        static void Stat(Entry &entry, int64_t &mod_time, int64_t &size)
+        {
+            struct stat info;
+            if (stat(entry.file_name.c_str(), &info))
+            {
+                mod_time = 0;
+                size = -1;
+                return;
+            }
+            mod_time = info.st_mtime;
+            size = info.st_size;
+        }
+
+        void MarkChanged(Entry &entry, uint64_t time)
+        {
+            entry.pending = 1;
+            entry.last_change = time;
+        }
+
+        void Poll(uint64_t time) // Only checks the entries that aren't watched by inotify.
+        {
+            for (auto &entry : entries)
+            {
+                if (entry.watch_descriptor != -1)
+                    continue;
+                int64_t mod_time, size;
+                Stat(entry, mod_time, size);
+                if (mod_time != entry.mod_time || size != entry.size)
+                {
+                    entry.mod_time = mod_time;
+                    entry.size = size;
+                    MarkChanged(entry, time);
+                }
+            }
+        }
+
+        void ReadEvents(uint64_t time)
+        {
+            #ifdef FILE_WATCHER_INOTIFY
+            alignas(inotify_event) char buffer[4096];
+            while (1)
+            {
+                ssize_t len = read(inotify_fd, buffer, sizeof buffer);
+                if (len <= 0) // The descriptor is non-blocking, so this means that there are no more events.
+                    return;
+
+                for (char *ptr = buffer; ptr < buffer + len;)
+                {
+                    const inotify_event &event = *(const inotify_event *)ptr;
+                    ptr += sizeof(inotify_event) + event.len;
+
+                    if (event.len == 0)
+                        continue;
+                    for (auto &entry : entries)
+                    {
+                        if (entry.watch_descriptor == event.wd && entry.base_name == event.name)
+                            MarkChanged(entry, time);
+                    }
+                }
+            }
+            #else
+            (void)time;
+            #endif
+        }
+    };
+
+    void FileWatcher::Handle::Destroy()
+    {
+        if (!id)
+            return;
+        if (auto ptr = data.lock())
+        {
+            for (auto &entry : ptr->entries)
+                entry.callbacks.erase(std::remove_if(entry.callbacks.begin(), entry.callbacks.end(), [&](const auto &callback){return callback.first == id;}), entry.callbacks.end());
+        }
+        data.reset();
+        id = 0;
+    }
+
+    FileWatcher::FileWatcher() : data(std::make_shared<Data>()) {}
+    FileWatcher::FileWatcher(FileWatcher &&) noexcept = default;
+    FileWatcher &FileWatcher::operator=(FileWatcher &&) noexcept = default;
+    FileWatcher::~FileWatcher() = default;
+
+    FileWatcher::Handle FileWatcher::Watch(const std::string &file_name, std::function<void()> callback)
+    {
+        Handle handle;
+        handle.data = data;
+        handle.id = data->next_id++;
+
+        for (auto &entry : data->entries)
+        {
+            if (entry.file_name == file_name)
+            {
+                entry.callbacks.emplace_back(handle.id, std::move(callback));
+                return handle;
+            }
+        }
+
+        Data::Entry entry;
+        entry.file_name = file_name;
+        entry.callbacks.emplace_back(handle.id, std::move(callback));
+
+        std::size_t sep = file_name.find_last_of("/\\");
+        std::string dir = (sep == std::string::npos ? "." : file_name.substr(0, sep));
+        entry.base_name = (sep == std::string::npos ? file_name : file_name.substr(sep + 1));
+
+        Data::Stat(entry, entry.mod_time, entry.size);
+
+        #ifdef FILE_WATCHER_INOTIFY
+        if (data->inotify_fd != -1)
+        {
+            // Watching the directory instead of the file itself, since editors often save files by replacing them.
+            entry.watch_descriptor = inotify_add_watch(data->inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE);
+        }
+        #else
+        (void)dir;
+        #endif
+
+        data->entries.push_back(std::move(entry));
+        return handle;
+    }
+
+    void FileWatcher::SetSettleTime(int ms)
+    {
+        data->settle_time = Timing::Tpms() * ms;
+    }
+    void FileWatcher::SetPollInterval(int ms)
+    {
+        data->poll_interval = Timing::Tpms() * ms;
+    }
+
+    void FileWatcher::Tick()
+    {
+        uint64_t time = Timing::Clock();
+
+        if (data->inotify_fd != -1)
+            data->ReadEvents(time);
+
+        if (time - data->last_poll >= data->poll_interval)
+        {
+            data->last_poll = time;
+            data->Poll(time);
+        }
+
+        for (std::size_t i = 0; i < data->entries.size(); i++) // Sic! Callbacks can add new entries.
+        {
+            auto &entry = data->entries[i];
+            if (!entry.pending || time - entry.last_change < data->settle_time)
+                continue;
+            entry.pending = 0;
+
+            std::vector<uint64_t> ids;
+            for (const auto &callback : entry.callbacks)
+                ids.push_back(callback.first);
+            for (uint64_t id : ids)
+            {
+                // Callbacks can unregister other callbacks and add new entries, so the callback is looked up again every time.
+                auto &callbacks = data->entries[i].callbacks;
+                auto it = std::find_if(callbacks.begin(), callbacks.end(), [&](const auto &callback){return callback.first == id;});
+                if (it == callbacks.end())
+                    continue;
+                auto func = it->second; // A copy, since the callback can unregister itself.
+                func();
+            }
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef FILE_WATCHER_H_INCLUDED
+#define FILE_WATCHER_H_INCLUDED
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace Utils
+{
+    /* Notices when files change and runs the respective callbacks from `Tick()`.
+     * On Linux inotify is used. Otherwise (or if inotify is unavailable) the modification time and size of each file are polled.
+     * Bursts of writes are coalesced: a callback runs only after the file stays unchanged for the settle time.
+     */
+    class FileWatcher
+    {
+        struct Data;
+        std::shared_ptr<Data> data; // Shared with `Handle`s, so they can outlive the watcher.
+
+      public:
+        /* Unregisters its callback when destroyed.
+         * Copying gives a null handle, so an object that owns a handle stays copyable, and the copy can register its own callback.
+         */
+        class Handle
+        {
+            friend class FileWatcher;
+            std::weak_ptr<Data> data;
+            uint64_t id = 0;
+
+          public:
+            Handle() {}
+            Handle(const Handle &) {}
+            Handle(Handle &&other) noexcept : data(std::move(other.data)), id(other.id) {other.id = 0;}
+            Handle &operator=(const Handle &other)
+            {
+                if (&other != this)
+                    Destroy();
+                return *this;
+            }
+            Handle &operator=(Handle &&other) noexcept
+            {
+                if (&other == this)
+                    return *this;
+                Destroy();
+                data = std::move(other.data);
+                id = other.id;
+                other.id = 0;
+                return *this;
+            }
+            ~Handle()
+            {
+                Destroy();
+            }
+
+            void Destroy(); // Unregisters the callback. Can be called from a callback.
+            [[nodiscard]] bool Exists() const
+            {
+                return id != 0;
+            }
+            [[nodiscard]] explicit operator bool() const
+            {
+                return Exists();
+            }
+        };
+
+        FileWatcher();
+        FileWatcher(FileWatcher &&) noexcept;
+        FileWatcher &operator=(FileWatcher &&) noexcept;
+        ~FileWatcher();
+
+        [[nodiscard]] Handle Watch(const std::string &file_name, std::function<void()> callback); // A file can have several callbacks. The file doesn't have to exist yet. The callback is active while the handle exists.
+
+        void SetSettleTime(int ms); // 200 by default.
+        void SetPollInterval(int ms); // 250 by default. Only used when polling.
+
+        void Tick(); // Call this regularly from the thread that should run the callbacks.
+    };
+}
+
+#endif
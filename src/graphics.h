@@ -3,10 +3,13 @@
 
 #include <algorithm>
 #include <bitset>
+#include <cmath>
 #include <cstddef>
 #include <functional>
 #include <initializer_list>
 #include <ios>
+#include <limits>
+#include <mutex>
 #include <numeric>
 #include <string>
 #include <type_traits>
@@ -25,6 +28,7 @@
 #include "program.h"
 #include "reflection.h"
 #include "template_utils.h"
+#include "threads.h"
 #include "utils.h"
 
 /* GLSL version chart:
@@ -348,6 +352,7 @@ namespace Graphics
 
         int height = 0, ascent = 0, line_skip = 0;
         bool enable_line_gap = 1;
+        int sdf_spread = 0;
         std::vector<CharPack> data{0x10000 / pack_size};
 
         using kerning_func_t = std::function<int(uint16_t, uint16_t)>;
@@ -393,6 +398,12 @@ namespace Graphics
         int LineSkip() const {return enable_line_gap ? line_skip : height;}
         int LineGap() const {return LineSkip() - height;}
 
+        void SetSdfSpread(int new_sdf_spread) // 0 means that the glyphs are plain bitmaps. Otherwise they are signed distance fields, see `Font::sdf`.
+        {
+            sdf_spread = new_sdf_spread;
+        }
+        int SdfSpread() const {return sdf_spread;}
+
         void SetKerning(kerning_func_t func)
         {
             kerning_func = func;
@@ -414,8 +425,10 @@ namespace Graphics
         struct FreetypeFontFuncs
         {
             template <typename> friend class ::Utils::Handle;
+            inline static std::mutex library_mutex; // Fonts can be created on worker threads. Faces share the library, so creating and destroying them must be serialized.
             static FT_Face Create(const std::string &/*display_name*/, const void *data, std::size_t data_size, int font_index)
             {
+                std::lock_guard lock(library_mutex);
                 static FT_Library lib = 0;
                 if (!lib)
                 {
@@ -436,6 +449,7 @@ namespace Graphics
             }
             static void Destroy(FT_Face value)
             {
+                std::lock_guard lock(library_mutex);
                 FT_Done_Face(value);
             }
             static void Error(const std::string &display_name, const void *, std::size_t, int)
@@ -447,6 +461,7 @@ namespace Graphics
 
         Utils::MemoryFile file;
         FreetypeFont ft_font;
+        int sdf_spread = 4;
 
       public:
         Font() {}
@@ -545,11 +560,19 @@ namespace Graphics
             return (bool)FT_Get_Char_Index(*ft_font, ch);
         }
 
+        void SetSdfSpread(int new_sdf_spread) // In pixels. Affects glyphs rendered in `sdf` mode. The default is 4.
+        {
+            DebugAssert("SDF spread must be positive.", new_sdf_spread > 0);
+            sdf_spread = new_sdf_spread;
+        }
+        int SdfSpread() const {return sdf_spread;}
+
         enum RenderMode
         {
             normal = FT_LOAD_TARGET_NORMAL,
             light  = FT_LOAD_TARGET_LIGHT,
             mono   = FT_LOAD_TARGET_MONO,
+            sdf    = -1, // Signed distance field, computed from a `normal` glyph. Each glyph gets `SdfSpread()` pixels of padding on each side. Alpha 0.5 is the edge. Such atlases should be used with a linearly interpolated texture.
         };
 
         struct CharData
@@ -564,10 +587,97 @@ namespace Graphics
                 for (int x = 0; x < size.x; x++)
                     ((u8vec4 *)img.Data())[img.Size().x * (y + pos.y) + x + pos.x] = color.to_vec4(data[size.x * y + x]);
             }
+
+            void ToDistanceField(int spread) // Replaces the coverage bitmap with a signed distance field, adding `spread` pixels of padding on each side.
+            {
+                if (size.x == 0 || size.y == 0)
+                    return;
+
+                constexpr float far = 1e20;
+
+                ivec2 new_size = size + spread * 2;
+                std::vector<float> outside(new_size.product()), inside(new_size.product());
+                for (int y = 0; y < new_size.y; y++)
+                for (int x = 0; x < new_size.x; x++)
+                {
+                    ivec2 src = ivec2(x,y) - spread;
+                    bool covered = (src >= 0).all() && (src < size).all() && data[size.x * src.y + src.x] >= 128;
+                    outside[new_size.x * y + x] = covered ? 0 : far;
+                    inside [new_size.x * y + x] = covered ? far : 0;
+                }
+
+                SquaredDistanceTransform(outside, new_size);
+                SquaredDistanceTransform(inside, new_size);
+
+                data.resize(new_size.product());
+                for (std::size_t i = 0; i < data.size(); i++)
+                {
+                    // Positive outside of the glyph. The edge lies between pixel centers, hence the 0.5.
+                    float dist = (inside[i] > 0 ? 0.5f - std::sqrt(inside[i]) : std::sqrt(outside[i]) - 0.5f);
+                    data[i] = std::lround(clamp(0.5f - dist / (spread * 2), 0, 1) * 255);
+                }
+
+                size = new_size;
+                offset -= spread;
+            }
+
+          private:
+            static void SquaredDistanceTransform(std::vector<float> &grid, ivec2 size) // Felzenszwalb & Huttenlocher. Zero cells are the features, the rest should be set to a large number.
+            {
+                int len = std::max(size.x, size.y);
+                std::vector<float> f(len), z(len+1);
+                std::vector<int> v(len);
+
+                auto Pass = [&](float *first, int count, int stride)
+                {
+                    for (int i = 0; i < count; i++)
+                        f[i] = first[i * stride];
+
+                    int k = 0;
+                    v[0] = 0;
+                    z[0] = -std::numeric_limits<float>::infinity();
+                    z[1] = std::numeric_limits<float>::infinity();
+                    for (int q = 1; q < count; q++)
+                    {
+                        float s;
+                        while (1)
+                        {
+                            s = ((f[q] + q*q) - (f[v[k]] + v[k]*v[k])) / (2*q - 2*v[k]);
+                            if (s > z[k])
+                                break;
+                            k--;
+                        }
+                        k++;
+                        v[k] = q;
+                        z[k] = s;
+                        z[k+1] = std::numeric_limits<float>::infinity();
+                    }
+
+                    k = 0;
+                    for (int q = 0; q < count; q++)
+                    {
+                        while (z[k+1] < q)
+                            k++;
+                        first[q * stride] = (q - v[k]) * (q - v[k]) + f[v[k]];
+                    }
+                };
+
+                for (int x = 0; x < size.x; x++)
+                    Pass(grid.data() + x, size.y, size.x);
+                for (int y = 0; y < size.y; y++)
+                    Pass(grid.data() + size.x * y, size.x, 1);
+            }
         };
 
         CharData GetChar(uint16_t ch, RenderMode mode) // Freetype caches the last rendered glyph for each font. After you render another one, the returned image reference is no longer valid.
         {
+            if (mode == sdf)
+            {
+                CharData ret = GetChar(ch, normal);
+                ret.ToDistanceField(sdf_spread);
+                return ret;
+            }
+
             if (FT_Load_Char(*ft_font, ch, FT_LOAD_RENDER | mode))
                 throw cant_render_glyph(ch, "Unknown.");
             auto glyph = (*ft_font)->glyph;
@@ -613,7 +723,7 @@ namespace Graphics
                 : font(font), map(map), mode(mode), chars(char_range.begin(), char_range.end()), kerning(kerning) {}
         };
 
-        static void MakeAtlas(Image &img, ivec2 pos, ivec2 size, Utils::ViewRange<AtlasEntry> entries_range)
+        static void MakeAtlas(Image &img, ivec2 pos, ivec2 size, Utils::ViewRange<AtlasEntry> entries_range, Threads::Pool *pool = 0) // If `pool` is specified, distance fields for `sdf` glyphs are computed in parallel.
         {
             DebugAssert("A rectange specified for a font atlas doesn't fit into the image.", (pos >= 0).all() && (pos + size <= img.Size()).all());
             std::vector<AtlasEntry> entries(entries_range.begin(), entries_range.end());
@@ -626,8 +736,8 @@ namespace Graphics
             stbrp_init_target(&packer_context, size.x-1, size.y-1, packer_buffer.data(), packer_buffer.size()); // -1 is for 1 pixel margin. No cleanup is necessary, as well as no error checking.
             std::vector<CharData> chars;
             chars.reserve(ch_count);
-            std::vector<stbrp_rect> char_rects;
-            char_rects.reserve(ch_count);
+            std::vector<int> sdf_spreads; // For each element of `chars`, 0 if it's not a distance field.
+            sdf_spreads.reserve(ch_count);
             for (auto &entry : entries)
             {
                 auto new_end = std::remove_if(entry.chars.begin(), entry.chars.end(), [&](uint16_t ch){return ch == 0xffff || !entry.font.HasChar(ch);});
@@ -639,14 +749,36 @@ namespace Graphics
 
                 for (const auto &ch : entry.chars)
                 {
-                    auto font_ch = entry.font.GetChar(ch, entry.mode);
-                    stbrp_rect rect;
-                    rect.w = font_ch.size.x + 1; // 1 pixel margin
-                    rect.h = font_ch.size.y + 1;
-                    char_rects.push_back(rect);
-                    chars.push_back(std::move(font_ch));
+                    // FreeType isn't thread-safe, so the glyphs are rendered here, and distance fields are computed later.
+                    chars.push_back(entry.font.GetChar(ch, entry.mode == sdf ? normal : entry.mode));
+                    sdf_spreads.push_back(entry.mode == sdf ? entry.font.SdfSpread() : 0);
                 }
             }
+
+            auto MakeDistanceField = [&](int i)
+            {
+                if (sdf_spreads[i])
+                    chars[i].ToDistanceField(sdf_spreads[i]);
+            };
+            if (pool && std::any_of(sdf_spreads.begin(), sdf_spreads.end(), [](int spread){return spread != 0;})) // Without distance fields there's nothing worth scheduling.
+            {
+                pool->ParallelFor(0, chars.size(), MakeDistanceField);
+            }
+            else
+            {
+                for (std::size_t i = 0; i < chars.size(); i++)
+                    MakeDistanceField(i);
+            }
+
+            std::vector<stbrp_rect> char_rects;
+            char_rects.reserve(ch_count);
+            for (const auto &font_ch : chars)
+            {
+                stbrp_rect rect;
+                rect.w = font_ch.size.x + 1; // 1 pixel margin
+                rect.h = font_ch.size.y + 1;
+                char_rects.push_back(rect);
+            }
             if (!stbrp_pack_rects(&packer_context, char_rects.data(), char_rects.size()))
                 throw not_enough_texture_atlas_space(pos, size);
             int i = 0;
@@ -654,6 +786,7 @@ namespace Graphics
             {
                 entry.map.SetMetrics(entry.font.Height(), entry.font.Ascent(), entry.font.LineSkip());
                 entry.map.SetKerning(entry.font.KerningFunc());
+                entry.map.SetSdfSpread(entry.mode == sdf ? entry.font.SdfSpread() : 0);
                 for (const auto &ch : entry.chars)
                 {
                     ivec2 dst_pos = pos + ivec2(char_rects[i].x, char_rects[i].y) + 1;
@@ -5,16 +5,20 @@
 #include <list>
 #include <map>
 #include <numeric>
+#include <optional>
 #include <set>
+#include <string_view>
 #include <unordered_map>
+#include <variant>
 
 constexpr ivec2 screen_sz = ivec2(1920,1080)/3;
 constexpr int tile_size = 12;
+constexpr int ticks_per_second = 60;
 
 Events::AutoErrorHandlers error_handlers;
 
 Window win("Meow", screen_sz * 2, Window::Settings{}.MinSize(screen_sz).Resizable());
-Timing::TickStabilizer tick_stabilizer(60);
+Timing::TickStabilizer tick_stabilizer(ticks_per_second);
 
 Graphics::Texture texture_main(Graphics::Texture::nearest),
                   texture_fbuf_main(Graphics::Texture::nearest, screen_sz), texture_fbuf_scaled(Graphics::Texture::linear);
@@ -27,6 +31,10 @@ Graphics::CharMap font_tiny;
 
 Renderers::Poly2D r;
 
+Threads::Pool jobs(0); // For splitting work across cores. Can be used from `loader` tasks too, so it's declared first and destroyed last.
+Assets::Loader loader;
+Utils::FileWatcher file_watcher;
+
 Input::Mouse mouse;
 
 namespace Shaders
@@ -66,9 +74,10 @@ namespace Draw
     {
         void WithBlackOutline(Renderers::Poly2D::Text_t &obj) // Is a preset
         {
+            obj.outline(fvec3(0), 0.6, 1); // Distance field fonts draw the outline in the shader.
             obj.callback([](Renderers::Poly2D::Text_t::CallbackParams params)
             {
-                if (params.render_pass && params.render.size())
+                if (params.render_pass && params.render.size() && !params.obj.state().ch_map->SdfSpread())
                 {
                     constexpr ivec2 offset_list[]{{1,0},{1,1},{0,1},{-1,1},{-1,0},{-1,-1},{0,-1},{1,-1}};
                     auto copy = params.render[0];
@@ -163,20 +172,43 @@ namespace Draw
         mouse.Transform(win.Size() / 2, screen_sz.x / float(Draw::scaled_size.x));
     }
 
-    void ReloadTextures()
+    void ReloadTextures() // The texture and the fonts are loaded in the background and are replaced in `loader.Tick()`.
     {
-        Graphics::Image textureimage_main("assets/texture.png");
-        Graphics::Font::MakeAtlas(textureimage_main, ivec2(0,256), ivec2(256,256),
+        struct Result
         {
-            {font_object_main, font_main, Graphics::Font::light, Strings::Encodings::cp1251()},
-            {font_object_tiny, font_tiny, Graphics::Font::light, Strings::Encodings::cp1251()},
-        });
-        /*
-        font_main.EnableLineGap(0);
-        font_tiny.EnableLineGap(0);
-        */
+            Graphics::Image image;
+            Graphics::Font object_main, object_tiny;
+            Graphics::CharMap main, tiny;
+        };
 
-        texture_main.SetData(textureimage_main);
+        loader.Load([]
+        {
+            Result ret;
+            ret.image = Graphics::Image(Utils::MemoryFile("assets/texture.png"));
+            ret.object_main.Create("assets/CatIV15.ttf", 15);
+            ret.object_tiny.Create("assets/CatTiny11.ttf", 11);
+            Graphics::Font::MakeAtlas(ret.image, ivec2(0,256), ivec2(256,256),
+            {
+                {ret.object_main, ret.main, Graphics::Font::light, Strings::Encodings::cp1251()},
+                {ret.object_tiny, ret.tiny, Graphics::Font::light, Strings::Encodings::cp1251()},
+            }, &jobs);
+            /*
+            ret.main.EnableLineGap(0);
+            ret.tiny.EnableLineGap(0);
+            */
+            return ret;
+        },
+        [](Result &&result)
+        {
+            // Char maps refer to the font objects (for kerning), so both are replaced at once.
+            font_main = std::move(result.main);
+            font_tiny = std::move(result.tiny);
+            font_object_main = std::move(result.object_main);
+            font_object_tiny = std::move(result.object_tiny);
+
+            texture_main.SetData(result.image);
+            r.SetTexture(texture_main); // This updates the texture size.
+        });
     }
 
     void Init()
@@ -189,13 +221,13 @@ namespace Draw
         Graphics::Blending::Enable();
         Graphics::Blending::FuncNormalPre();
 
-        font_object_main.Create("assets/CatIV15.ttf", 15);
-        font_object_tiny.Create("assets/CatTiny11.ttf", 11);
-
-        ReloadTextures();
-
         r.Create(0x10000);
         r.SetTexture(texture_main);
+
+        ReloadTextures();
+        static std::vector<Utils::FileWatcher::Handle> texture_watches;
+        for (const char *name : {"assets/texture.png", "assets/CatIV15.ttf", "assets/CatTiny11.ttf"})
+            texture_watches.push_back(file_watcher.Watch(name, ReloadTextures));
         r.SetMatrix(fmat4::ortho2D(screen_sz / ivec2(-2,2), screen_sz / ivec2(2,-2)));
         r.SetDefaultFont(font_main);
 
@@ -310,9 +342,9 @@ namespace Objects
                         throw std::runtime_error(Str("Duplicate tile named `", *it, "` in group `", name, "`."));
                 }
 
-                bool Contains(std::string name) const
+                bool Contains(std::string_view name) const
                 {
-                    return std::binary_search(tiles.begin(), tiles.end(), name);
+                    return std::binary_search(tiles.begin(), tiles.end(), name, std::less<>{});
                 }
                 bool Contains(int index) const
                 {
@@ -354,7 +386,10 @@ namespace Objects
                         throw std::runtime_error(Str("Variant `", name, "` of tile `", tile_name, "` has non-positive size."));
                     if ((texture < 0).any() || (texture + size > sheet_size).any())
                         throw std::runtime_error(Str("Texture coordinates for variant `", name, "` of tile `", tile_name, "` are out of range."));
+                }
 
+                void Link() // Computes the values that aren't reflected. This is not const to prevent calling it from outside.
+                {
                     small = (size == ivec2(1));
                     effective_texture_pixel_pos    = sheet_tex_pos + (texture + offset + tex_offset) * tile_size;
                     effective_texture_pixel_size   = size * tile_size;
@@ -460,9 +495,7 @@ namespace Objects
                         if ((modulo_pos.size < 1).any())
                             throw std::runtime_error(Str("Rectangle size for modulo position for the rule ", original_index, " for tile `", tile_name, "` is smaller than 1 in at least one dimension."));
 
-                        modulo_pos.apply = (modulo_pos.size != ivec2(1));
-
-                        if (modulo_pos.apply && modulo_pos.offsets.empty())
+                        if (modulo_pos.size != ivec2(1) && modulo_pos.offsets.empty())
                             throw std::runtime_error(Str("List of modulo offsets for the rule ", original_index, " for tile `", tile_name, "` is empty."));
 
                         for (const auto &offset : modulo_pos.offsets)
@@ -484,8 +517,14 @@ namespace Objects
                                 vec.insert(vec.end(), tmp.begin(), tmp.end());
                             }
                         }
+                        matrices.clear(); // So that finalized rules can be cached and linked without applying the matrices again.
                     }
                 }
+
+                void Link()
+                {
+                    modulo_pos.apply = (modulo_pos.size != ivec2(1));
+                }
             };
 
             struct Tile
@@ -511,17 +550,17 @@ namespace Objects
                     return flag_array[flag_index];
                 }
 
-                int VariantIndex(std::string variant_name) // This is not const to prevent calling it from outside.
+                int VariantIndex(std::string_view variant_name) // This is not const to prevent calling it from outside.
                 {
-                    auto it = std::lower_bound(variants.begin(), variants.end(), variant_name);
+                    auto it = std::lower_bound(variants.begin(), variants.end(), variant_name, [](const TileVariant &a, std::string_view b){return a.name < b;});
                     if (it == variants.end() || it->name != variant_name)
                         return -1;
                     return it - variants.begin();
                 }
 
-                const TileVariant &Variant(std::string variant_name) const
+                const TileVariant &Variant(std::string_view variant_name) const
                 {
-                    auto it = std::lower_bound(variants.begin(), variants.end(), variant_name);
+                    auto it = std::lower_bound(variants.begin(), variants.end(), variant_name, [](const TileVariant &a, std::string_view b){return a.name < b;});
                     if (it == variants.end() || it->name != variant_name)
                         throw std::runtime_error(Str("Tile `", name, "` has no variant `", variant_name, "`."));
                     return *it;
@@ -558,13 +597,6 @@ namespace Objects
                         // Check for duplicates
                         if (auto it = std::adjacent_find(variants.begin(), variants.end()); it != variants.end())
                             throw std::runtime_error(Str("Duplicate variant `", it->name, "` for tile `", name, "`."));
-                        // Get indices for default/display variants
-                        va_default_index = VariantIndex(va_default);
-                        if (va_default_index == -1)
-                            throw std::runtime_error(Str("Default variant `", va_default, "` for tile `", name, "` doesn't exist."));
-                        va_display_index = VariantIndex(va_display);
-                        if (va_display_index == -1)
-                            throw std::runtime_error(Str("Display variant `", va_display, "` for tile `", name, "` doesn't exist."));
                     }
 
                     { // Rules
@@ -593,30 +625,50 @@ namespace Objects
                                 rule_it++;
                             }
                         }
+                        for (auto &it : rules)
+                            it.duplicate.clear(); // So that finalized rules can be cached and linked without duplicating them again.
 
                         // Finalize
                         for (auto &it : rules)
                             it.Finalize(name);
+                    }
+                }
+
+                void Link() // Resolves variant names to indices and computes the values that aren't reflected. Throws if some names are invalid.
+                {
+                    for (auto &it : variants)
+                        it.Link();
+
+                    { // Get indices for default/display variants
+                        va_default_index = VariantIndex(va_default);
+                        if (va_default_index == -1)
+                            throw std::runtime_error(Str("Default variant `", va_default, "` for tile `", name, "` doesn't exist."));
+                        va_display_index = VariantIndex(va_display);
+                        if (va_display_index == -1)
+                            throw std::runtime_error(Str("Display variant `", va_display, "` for tile `", name, "` doesn't exist."));
+                    }
 
-                        // Get variant indices for results and required variants
-                        for (auto &rule : rules)
+                    // Get variant indices for results and required variants
+                    for (auto &rule : rules)
+                    {
+                        rule.Link();
+
+                        for (auto &result : rule.results)
                         {
-                            for (auto &result : rule.results)
-                            {
-                                result.index = VariantIndex(result.name);
-                                if (result.index == -1)
-                                    throw std::runtime_error(Str("A tiling rule result for tile `", name, "` references non-existent variant named `", result.name, "`."));
-                            }
+                            result.index = VariantIndex(result.name);
+                            if (result.index == -1)
+                                throw std::runtime_error(Str("A tiling rule result for tile `", name, "` references non-existent variant named `", result.name, "`."));
+                        }
 
-                            for (const auto &va_name : rule.req_variants)
-                            {
-                                int index = VariantIndex(va_name);
-                                if (index == -1)
-                                    throw std::runtime_error(Str("A tiling rule for tile `", name, "` references non-existent variant named `", va_name, "`."));
-                                rule.req_variant_indices.push_back(index);
-                            }
-                            std::sort(rule.req_variant_indices.begin(), rule.req_variant_indices.end());
+                        rule.req_variant_indices.clear();
+                        for (const auto &va_name : rule.req_variants)
+                        {
+                            int index = VariantIndex(va_name);
+                            if (index == -1)
+                                throw std::runtime_error(Str("A tiling rule for tile `", name, "` references non-existent variant named `", va_name, "`."));
+                            rule.req_variant_indices.push_back(index);
                         }
+                        std::sort(rule.req_variant_indices.begin(), rule.req_variant_indices.end());
                     }
                 }
 
@@ -646,7 +698,13 @@ namespace Objects
                 };
                 std::map<tile_id_t, TileInfo> tile_info;
 
-                std::map<std::string, std::map<std::string, tile_id_t>> indices_by_name;
+                Utils::Interner names; // Names of flags, groups, tiles and variants.
+                struct NameInfo
+                {
+                    int flag = -1, group = -1, tile = -1;
+                };
+                std::vector<NameInfo> name_info; // Indexed by ids from `names`.
+                std::unordered_map<uint64_t, tile_id_t> ids_by_name; // The keys are `tile_name_id << 32 | variant_name_id`, where the ids come from `names`.
                 tile_id_t global_index_count;
 
                 ivec2 autotiling_range;
@@ -656,36 +714,52 @@ namespace Objects
                       max_texture_offset_positive = ivec2(std::numeric_limits<int>::min());
 
 
-                bool GroupExists(std::string name) const
+                NameInfo &AddName(std::string_view name)
                 {
-                    return std::binary_search(groups.begin(), groups.end(), name);
+                    int id = names.Add(name);
+                    if (id >= int(name_info.size()))
+                        name_info.resize(id + 1);
+                    return name_info[id];
                 }
-                bool TileExists(std::string name) const
+                NameInfo FindName(std::string_view name) const // Returns a default-constructed object if there is no such name.
                 {
-                    return std::binary_search(tiles.begin(), tiles.end(), name);
+                    int id = names.Find(name);
+                    if (id == Utils::Interner::none || id >= int(name_info.size()))
+                        return {};
+                    return name_info[id];
+                }
+
+                bool GroupExists(std::string_view name) const
+                {
+                    return GroupIndex(name) != -1;
+                }
+                bool TileExists(std::string_view name) const
+                {
+                    return TileIndex(name) != -1;
                 }
 
                 // Those return -1 if there is no such object.
-                int TileFlagIndex(std::string name) const
+                int TileFlagIndex(std::string_view name) const
                 {
-                    auto it = std::lower_bound(flags.begin(), flags.end(), name);
-                    if (it == flags.end() || *it != name)
-                        return -1;
-                    return it - flags.begin();
+                    return FindName(name).flag;
                 }
-                int GroupIndex(std::string name) const
+                int GroupIndex(std::string_view name) const
                 {
-                    auto it = std::lower_bound(groups.begin(), groups.end(), name);
-                    if (it == groups.end() || it->name != name)
-                        return -1;
-                    return it - groups.begin();
+                    return FindName(name).group;
                 }
-                int TileIndex(std::string name) const
+                int TileIndex(std::string_view name) const
                 {
-                    auto it = std::lower_bound(tiles.begin(), tiles.end(), name);
-                    if (it == tiles.end() || it->name != name)
+                    return FindName(name).tile;
+                }
+                tile_id_t IndexByName(std::string_view tile_name, std::string_view variant_name) const // Returns -1 if no such tile or variant.
+                {
+                    int tile_id = names.Find(tile_name), variant_id = names.Find(variant_name);
+                    if (tile_id == Utils::Interner::none || variant_id == Utils::Interner::none)
+                        return -1;
+                    auto it = ids_by_name.find(uint64_t(tile_id) << 32 | uint64_t(variant_id));
+                    if (it == ids_by_name.end())
                         return -1;
-                    return it - tiles.begin();
+                    return it->second;
                 }
 
                 void Finalize()
@@ -719,10 +793,33 @@ namespace Objects
                         // Check for duplicates
                         if (auto it = std::adjacent_find(tiles.begin(), tiles.end()); it != tiles.end())
                             throw std::runtime_error(Str("A duplicate tile named `", it->name, "`."));
-                        // Check for collision with group names
-                        for (const auto &it : tiles)
-                            if (GroupExists(it.name))
-                                throw std::runtime_error(Str("A name collision between a tile named `", it.name, "` and a group with the same name."));
+                    }
+
+                    Link();
+                }
+
+                // Does the part of `Finalize()` that doesn't change the reflected fields: resolves names to indices and computes the rest of the fields.
+                // Data loaded from the cache only needs this, since it was finalized before saving. Throws if some names are invalid.
+                void Link()
+                {
+                    { // Add names
+                        for (std::size_t i = 0; i < flags.size(); i++)
+                            AddName(flags[i]).flag = i;
+                        for (std::size_t i = 0; i < groups.size(); i++)
+                            AddName(groups[i].name).group = i;
+                        for (std::size_t i = 0; i < tiles.size(); i++)
+                        {
+                            NameInfo &info = AddName(tiles[i].name);
+                            // Check for collision with group names
+                            if (info.group != -1)
+                                throw std::runtime_error(Str("A name collision between a tile named `", tiles[i].name, "` and a group with the same name."));
+                            info.tile = i;
+                        }
+                    }
+
+                    { // Tiles
+                        for (auto &it : tiles)
+                            it.Link();
 
                         // Handle flags
                         for (auto &it : tiles)
@@ -732,7 +829,7 @@ namespace Objects
                             for (const auto &flag : it.flags)
                             {
                                 int flag_index = TileFlagIndex(flag);
-                                if (flag_index == 1)
+                                if (flag_index == -1)
                                     throw std::runtime_error(Str("An invalid flag named `", flag, "` was specified for tile `", it.name, "`."));
                                 it.flag_array[flag_index] = 1;
                             }
@@ -760,12 +857,14 @@ namespace Objects
                         for (std::size_t tile_index = 0; tile_index < tiles.size(); tile_index++)
                         {
                             auto &tile = tiles[tile_index];
+                            uint64_t tile_name_id = names.Find(tile.name);
 
                             for (std::size_t variant_index = 0; variant_index < tile.variants.size(); variant_index++)
                             {
                                 auto &variant = tile.variants[variant_index];
                                 variant.global_index = index++;
-                                indices_by_name[tile.name][variant.name] = variant.global_index;
+                                uint64_t variant_name_id = names.Add(variant.name); // Variant names don't need `name_info`, so we don't use `AddName()`.
+                                ids_by_name.insert({tile_name_id << 32 | variant_name_id, variant.global_index});
 
                                 TileInfo info;
                                 info.tile_index = tile_index;
@@ -852,26 +951,235 @@ namespace Objects
 
             std::string file_name;
 
+            static constexpr uint32_t cache_version_magic = 1; // This should be changed when the binary structure of `Data` changes.
+
+            // The cache contains the finalized data, so loading it only requires `Data::Link()`.
+            // It's tied to the source file by its CRC32 and size. Returns null if the cache is missing, outdated or broken.
+            static std::optional<Data> LoadCache(const std::string &cache_name, uint32_t source_crc, uint32_t source_size)
+            {
+                try
+                {
+                    // Not mapped: another thread parsing the same file may rewrite the cache meanwhile, and truncating a mapped file crashes the reader with SIGBUS (or fails the write on Windows).
+                    // A copy that gets cut short by a concurrent write is caught by the checks in `CacheToData()`.
+                    Utils::MemoryFile file(cache_name);
+                    return CacheToData(file.Data(), file.Data() + file.Size(), source_crc, source_size);
+                }
+                catch (decltype(Utils::file_input_error("","")) &e)
+                {
+                    return {};
+                }
+            }
+
+            static bool SaveCache(const std::string &cache_name, uint32_t source_crc, uint32_t source_size, const Data &data)
+            {
+                std::vector<uint8_t> buf = DataToCache(data, source_crc, source_size);
+                return Utils::WriteToFile(cache_name, buf.data(), buf.size());
+            }
+
+            static std::optional<Data> CacheToData(const uint8_t *begin, const uint8_t *end, uint32_t source_crc, uint32_t source_size)
+            {
+                uint32_t magic, crc, size;
+                begin = Reflection::from_bytes<uint32_t>(magic, begin, end);
+                if (!begin || magic != cache_version_magic)
+                    return {};
+                begin = Reflection::from_bytes<uint32_t>(crc, begin, end);
+                if (!begin || crc != source_crc)
+                    return {};
+                begin = Reflection::from_bytes<uint32_t>(size, begin, end);
+                if (!begin || size != source_size)
+                    return {};
+
+                std::vector<int> original_indices; // `Tile::original_index` isn't reflected, but `Link()` needs it.
+                Data ret;
+                begin = Reflection::from_bytes(original_indices, begin, end);
+                if (!begin)
+                    return {};
+                begin = Reflection::from_bytes(ret, begin, end);
+                if (begin != end || original_indices.size() != ret.tiles.size())
+                    return {};
+
+                for (std::size_t i = 0; i < ret.tiles.size(); i++)
+                    ret.tiles[i].original_index = original_indices[i];
+                try
+                {
+                    ret.Link();
+                }
+                catch (std::runtime_error &e) // `Link()` failed, so the cache is broken.
+                {
+                    return {};
+                }
+                return ret;
+            }
+
+            static std::vector<uint8_t> DataToCache(const Data &data, uint32_t source_crc, uint32_t source_size)
+            {
+                std::vector<int> original_indices;
+                original_indices.reserve(data.tiles.size());
+                for (const auto &tile : data.tiles)
+                    original_indices.push_back(tile.original_index);
+
+                std::vector<uint8_t> ret(sizeof(uint32_t) * 3 + Reflection::byte_buffer_size(original_indices) + Reflection::byte_buffer_size(data));
+                uint8_t *ptr = ret.data();
+                for (uint32_t value : {cache_version_magic, source_crc, source_size})
+                    ptr = Reflection::to_bytes<uint32_t>(value, ptr);
+                ptr = Reflection::to_bytes(original_indices, ptr);
+                ptr = Reflection::to_bytes(data, ptr);
+                DebugAssert("Tiling cache size mismatch.", ptr == ret.data() + ret.size());
+                return ret;
+            }
+
+            // Returns the name of the first field that differs between `a` and `b`, or null if they are the same.
+            // This is used to check that loading the cache gives the same result as parsing the text.
+            static const char *FindDifference(const Data &a, const Data &b)
+            {
+                auto Bytes = [](const Data &data)
+                {
+                    std::vector<uint8_t> ret(Reflection::byte_buffer_size(data));
+                    Reflection::to_bytes(data, ret.data());
+                    return ret;
+                };
+                if (Bytes(a) != Bytes(b))
+                    return "reflected fields";
+
+                for (int i = 0; i < num_layers; i++)
+                {
+                    if (a.layer_tile_indices[i] != b.layer_tile_indices[i])
+                        return "layer_tile_indices";
+                }
+
+                if (a.tile_info.size() != b.tile_info.size())
+                    return "tile_info";
+                for (auto it_a = a.tile_info.begin(), it_b = b.tile_info.begin(); it_a != a.tile_info.end(); it_a++, it_b++)
+                {
+                    const auto &[id_a, info_a] = *it_a;
+                    const auto &[id_b, info_b] = *it_b;
+                    if (id_a != id_b || info_a.tile_index != info_b.tile_index || info_a.variant_index != info_b.variant_index || info_a.tile_name != info_b.tile_name || info_a.variant_name != info_b.variant_name)
+                        return "tile_info";
+                }
+
+                if (a.names.Size() != b.names.Size())
+                    return "names";
+                for (int i = 0; i < a.names.Size(); i++)
+                {
+                    if (a.names.String(i) != b.names.String(i))
+                        return "names";
+                }
+                if (a.name_info.size() != b.name_info.size())
+                    return "name_info";
+                for (std::size_t i = 0; i < a.name_info.size(); i++)
+                {
+                    if (a.name_info[i].flag != b.name_info[i].flag || a.name_info[i].group != b.name_info[i].group || a.name_info[i].tile != b.name_info[i].tile)
+                        return "name_info";
+                }
+                if (a.ids_by_name != b.ids_by_name)
+                    return "ids_by_name";
+
+                if (a.global_index_count != b.global_index_count)
+                    return "global_index_count";
+                if (a.autotiling_range != b.autotiling_range)
+                    return "autotiling_range";
+                if (a.max_texture_offset_negative != b.max_texture_offset_negative || a.max_texture_offset_positive != b.max_texture_offset_positive)
+                    return "max_texture_offset_*";
+
+                // The reflected fields are equal, so the vector sizes match.
+                for (std::size_t i = 0; i < a.groups.size(); i++)
+                {
+                    if (a.groups[i].indices != b.groups[i].indices)
+                        return "Group::indices";
+                }
+
+                for (std::size_t i = 0; i < a.tiles.size(); i++)
+                {
+                    const Tile &tile_a = a.tiles[i], &tile_b = b.tiles[i];
+                    if (tile_a.flag_array != tile_b.flag_array)
+                        return "Tile::flag_array";
+                    if (tile_a.original_index != tile_b.original_index)
+                        return "Tile::original_index";
+                    if (tile_a.va_default_index != tile_b.va_default_index || tile_a.va_display_index != tile_b.va_display_index)
+                        return "Tile::va_*_index";
+
+                    for (std::size_t j = 0; j < tile_a.variants.size(); j++)
+                    {
+                        const TileVariant &va_a = tile_a.variants[j], &va_b = tile_b.variants[j];
+                        if (va_a.global_index != va_b.global_index)
+                            return "TileVariant::global_index";
+                        if (va_a.Small() != va_b.Small() || va_a.TexturePos() != va_b.TexturePos() || va_a.TextureSize() != va_b.TextureSize() || va_a.TextureOffset() != va_b.TextureOffset())
+                            return "TileVariant texture parameters";
+                    }
+
+                    // `TileRule::original_index` isn't compared: it's not cached, and it's only used in error messages before `Finalize()` completes.
+                    for (std::size_t j = 0; j < tile_a.rules.size(); j++)
+                    {
+                        const TileRule &rule_a = tile_a.rules[j], &rule_b = tile_b.rules[j];
+                        if (rule_a.req_variant_indices != rule_b.req_variant_indices)
+                            return "TileRule::req_variant_indices";
+                        if (rule_a.modulo_pos.apply != rule_b.modulo_pos.apply)
+                            return "TileRule::modulo_pos.apply";
+                        for (std::size_t k = 0; k < rule_a.results.size(); k++)
+                        {
+                            if (rule_a.results[k].index != rule_b.results[k].index)
+                                return "TileRule::Result::index";
+                        }
+                        for (auto mem_ptr : {&TileRule::requires, &TileRule::requires_not})
+                        {
+                            for (std::size_t k = 0; k < (rule_a.*mem_ptr).size(); k++)
+                            {
+                                const TileRule::Requirement &req_a = (rule_a.*mem_ptr)[k], &req_b = (rule_b.*mem_ptr)[k];
+                                if (req_a.index != req_b.index || req_a.is_group != req_b.is_group)
+                                    return "TileRule::Requirement::index/is_group";
+                            }
+                        }
+                    }
+                }
+
+                return nullptr;
+            }
+
           public:
             Tiling(std::string file_name) : file_name(file_name)
             {
                 Reload(1);
             }
 
-            void Reload(bool fatal_errors = 0)
+            // Throws `std::runtime_error` if the file is invalid. Doesn't touch the global state, so it can be called from worker threads.
+            // The finalized data is cached in `<file_name>.cache`, and the text is only parsed if the file has changed since then.
+            static Data Parse(const std::string &file_name)
             {
-                Data data_copy = data;
-                data = {};
+                Utils::MemoryFile file(file_name); // Not mapped, since the file can be rewritten by an editor while we parse it.
+                uint32_t crc = crc32(0, file.Data(), file.Size()), size = file.Size();
+
+                std::string cache_name = file_name + ".cache";
+                if (auto ret = LoadCache(cache_name, crc, size))
+                    return std::move(*ret);
 
-                Utils::MemoryFile file(file_name);
+                Data ret;
+
+                std::string error_message;
+                if (auto ptr = Reflection::from_string(ret, (char *)file.Data(), &error_message); ptr != (char *)file.Data() + file.Size())
+                    throw std::runtime_error(Str("Unable to parse tiling settings:\n", (ptr == 0 ? error_message : "Extra data at the end of input.")));
+
+                ret.Finalize();
+                SaveCache(cache_name, crc, size, ret); // If this fails, the text will be parsed again next time, which is fine.
+
+                #ifndef NDEBUG
+                { // Make sure that the cache round-trips to the same data, including the derived fields.
+                    std::vector<uint8_t> cache = DataToCache(ret, crc, size);
+                    std::optional<Data> cached = CacheToData(cache.data(), cache.data() + cache.size(), crc, size);
+                    if (!cached)
+                        Program::Error("Unable to load the tiling cache that was just generated.");
+                    if (const char *field = FindDifference(ret, *cached))
+                        Program::Error(Str("Tiling cache mismatch: `", field, "` differs from the parsed text."));
+                }
+                #endif
 
+                return ret;
+            }
+
+            void Reload(bool fatal_errors = 0)
+            {
                 try
                 {
-                    std::string error_message;
-                    if (auto ptr = Reflection::from_string(data, (char *)file.Data(), &error_message); ptr != (char *)file.Data() + file.Size())
-                        throw std::runtime_error(Str("Unable to parse tiling settings:\n", (ptr == 0 ? error_message : "Extra data at the end of input.")));
-
-                    data.Finalize();
+                    data = Parse(file_name);
                 }
                 catch (std::runtime_error &e)
                 {
@@ -879,31 +1187,66 @@ namespace Objects
                         Program::Error(e.what());
 
                     UI::MessageBox("Error!", e.what(), UI::warning);
-                    data = data_copy;
                 }
             }
 
-            int FlagIndex(std::string name) const // This fails with a error if such flag doesn't exist.
+            void SetData(Data &&new_data) // Use this with `Parse()` to reload the settings asynchronously.
+            {
+                data = std::move(new_data);
+            }
+
+            const std::string &FileName() const
+            {
+                return file_name;
+            }
+
+            // Returns names of the tiles that were changed or added in `new_data`, compared to the current settings.
+            // Returns null if the flags or groups were changed or if some tiles were removed, since then any tile can be affected.
+            std::optional<std::set<std::string>> ChangedTiles(const Data &new_data) const
+            {
+                if (Reflection::to_string(data.flags) != Reflection::to_string(new_data.flags) ||
+                    Reflection::to_string(data.groups) != Reflection::to_string(new_data.groups))
+                    return {};
+
+                std::map<std::string, std::string> old_tiles;
+                for (const auto &tile : data.tiles)
+                    old_tiles.insert({tile.name, Reflection::to_string(tile)});
+
+                std::set<std::string> ret;
+                std::size_t old_tiles_found = 0;
+                for (const auto &tile : new_data.tiles)
+                {
+                    auto it = old_tiles.find(tile.name);
+                    if (it == old_tiles.end())
+                    {
+                        ret.insert(tile.name);
+                        continue;
+                    }
+                    old_tiles_found++;
+                    if (it->second != Reflection::to_string(tile))
+                        ret.insert(tile.name);
+                }
+                if (old_tiles_found != old_tiles.size())
+                    return {};
+
+                return ret;
+            }
+
+            int FlagIndex(std::string_view name) const // This fails with a error if such flag doesn't exist.
             {
-                auto it = std::lower_bound(data.flags.begin(), data.flags.end(), name);
-                if (it == data.flags.end() || *it != name)
+                int ret = data.TileFlagIndex(name);
+                if (ret == -1)
                     Program::Error(Str("Attempt to access non-existent tile flag `", name, "`."));
-                return it - data.flags.begin();
+                return ret;
             }
 
             int IndexCount() const // Valid tile_id_t values are: 0 <= x < IndexCount().
             {
                 return data.global_index_count;
             }
-            tile_id_t IndexByName(std::string tile_name, std::string variant_name) const // Returns -1 if no such tile or variant.
+            tile_id_t IndexByName(std::string_view tile_name, std::string_view variant_name) const // Returns -1 if no such tile or variant.
             {
-                auto tile_it = data.indices_by_name.find(tile_name);
-                if (tile_it == data.indices_by_name.end())
-                    return -1;
-                auto variant_it = tile_it->second.find(variant_name);
-                if (variant_it == tile_it->second.end())
-                    return -1;
-                return variant_it->second;
+                return data.IndexByName(tile_name, variant_name);
             }
             int GetTileIndex(tile_id_t id) const
             {
@@ -1024,13 +1367,23 @@ namespace Objects
 
         Data data;
 
-        ReflectStruct(ReflectedData, (
+      public:
+        ReflectStruct(ReflectedData, ( // This is what is saved to files. Tiles are referred to by names, so it doesn't depend on the tiling settings.
             (ivec2)(size),
             (std::vector<std::string>)(tile_names, variant_names),
             (std::vector<int>[layer_count])(layers),
         ))
+        ReflectStruct(ReflectedDataView, ( // Same binary layout as `ReflectedData`, but points into the file buffer instead of copying from it.
+            (ivec2)(size),
+            (std::vector<std::string_view>)(tile_names, variant_names),
+            (Reflection::ArrayView<int>[layer_count])(layers),
+        ))
+        struct FileContents // Binary files are not parsed into `ReflectedData`, instead a view is stored along with the file it points to.
+        {
+            Utils::MemoryFile file;
+            std::variant<ReflectedData, ReflectedDataView> refl;
+        };
 
-      public:
         Map() {}
         Map(std::string file_name) : file_name(file_name)
         {
@@ -1287,6 +1640,22 @@ namespace Objects
             for (int x = 0; x <= data.size.x; x++)
                 RunAutotilerForOneTile(ivec2(x,y));
         }
+        void RunAutotilerForTiles(const std::vector<bool> &tile_mask) // Runs autotiler only for the cells that contain a tile with `tile_mask[tile_index] == 1` on any layer.
+        {
+            for (int y = 0; y < data.size.y; y++)
+            for (int x = 0; x < data.size.x; x++)
+            {
+                for (int la = 0; la < layer_count; la++)
+                {
+                    tile_id_t id = data.Get<Unsafe>(ivec2(x,y), layer_list[la]);
+                    if (id != no_tile && tile_mask[tiling.GetTileIndex(id)])
+                    {
+                        RunAutotilerForOneTile(ivec2(x,y));
+                        break;
+                    }
+                }
+            }
+        }
 
         const std::string &FileName() const
         {
@@ -1297,7 +1666,7 @@ namespace Objects
             file_name = new_file_name;
         }
 
-        bool SaveToFile(bool forward_compat = 0, std::string suffix = "") const
+        ReflectedData ToReflectedData() const
         {
             ReflectedData refl;
             refl.size = data.size;
@@ -1314,11 +1683,21 @@ namespace Objects
                 for (int x = 0; x < data.size.x; x++)
                     layer.push_back(data.tiles[x + data.size.x * y].*layer_list[la]);
             }
+            return refl;
+        }
+
+        bool SaveToFile(bool forward_compat = 0, std::string suffix = "") const
+        {
+            ReflectedData refl = ToReflectedData();
 
             if (forward_compat)
             {
-                std::string str = Reflection::to_string(refl);
-                return Utils::WriteToFile(file_name + ".fwdcompat" + suffix, (uint8_t *)str.data(), str.size());
+                return Utils::WriteToFile(file_name + ".fwdcompat" + suffix, [&](std::FILE *file)
+                {
+                    Reflection::Writer writer(file); // Writes in blocks, the text is never assembled in memory.
+                    Reflection::write_string(refl, writer);
+                    return writer.flush();
+                });
             }
             else
             {
@@ -1331,48 +1710,54 @@ namespace Objects
                 return Utils::WriteToFile(file_name + suffix, buf.get(), len, Utils::compressed);
             }
         }
-        bool LoadFromFile(bool forward_compat = 0)
+        static std::optional<FileContents> ReadFile(const std::string &file_name, bool forward_compat = 0) // Doesn't depend on the tiling settings, so it can be called from worker threads.
         {
-            Utils::MemoryFile file;
+            FileContents ret;
+
             try
             {
                 if (forward_compat)
-                    file.Create(file_name + ".fwdcompat");
+                {
+                    ReflectedData refl;
+                    Utils::MemoryFile file(file_name + ".fwdcompat");
+                    if (!Reflection::from_string(refl, (char *)file.Data())) // `MemoryFile::Data()` is null-terminated, so we're fine.
+                        return {};
+                    ret.refl = std::move(refl);
+                }
                 else
-                    file.Create(file_name, Utils::compressed);
+                {
+                    // The file is decompressed into a single buffer, and the view points into it. Nothing else is allocated except for the small name lists.
+                    ret.file.Create(file_name, Utils::compressed);
+                    ReflectedDataView view;
+                    const uint8_t *begin = ret.file.Data(), *end = ret.file.Data() + ret.file.Size();
+                    uint32_t magic;
+                    begin = Reflection::from_bytes<uint32_t>(magic, begin, end);
+                    if (!begin || magic != version_magic)
+                        return {};
+                    begin = Reflection::from_bytes(view, begin, end);
+                    if (begin != end)
+                        return {};
+                    ret.refl = view;
+                }
             }
             catch(decltype(Utils::file_input_error("","")) &e)
             {
-                return 0;
+                return {};
             }
 
-            ReflectedData refl;
+            return ret;
+        }
 
-            bool ok;
-            if (forward_compat)
-            {
-                ok = Reflection::from_string(refl, (char *)file.Data()); // `MemoryFile::Data()` is null-terminated, so we're fine.
-            }
-            else
+        template <typename R> bool FromReflectedData(const R &refl) // Converts tile names to ids using the current tiling settings. Accepts either `ReflectedData` or `ReflectedDataView`.
+        {
+            if (refl.tile_names.size() != refl.variant_names.size() || refl.size.min() < 0)
+                return 0;
+            for (const auto &layer : refl.layers)
             {
-                ok = 0;
-                const uint8_t *begin = file.Data(), *end = file.Data() + file.Size();
-                uint32_t magic;
-                begin = Reflection::from_bytes<uint32_t>(magic, begin, end);
-                if (begin && magic == version_magic)
-                {
-                    begin = Reflection::from_bytes(refl, begin, end);
-                    if (begin == end)
-                        ok = 1;
-                }
+                if (layer.size() != std::size_t(refl.size.product()))
+                    return 0;
             }
 
-            if (!ok)
-                return 0;
-
-            if (refl.tile_names.size() != refl.variant_names.size())
-                return 0;
-
             int indices_in_file = refl.tile_names.size();
 
             Data new_data; // There is no real need in operating on a copy for now, but we still do it.
@@ -1383,28 +1768,43 @@ namespace Objects
             for (int index = 0; index < indices_in_file; index++)
                 mapping.push_back(tiling.IndexByName(refl.tile_names[index], refl.variant_names[index]));
 
-            for (int la = 0; la < layer_count; la++)
-            for (int y = 0; y < new_data.size.y; y++)
-            for (int x = 0; x < new_data.size.x; x++)
+            jobs.ParallelFor(ivec2(0), new_data.size, [&](ivec2 pos)
             {
-                int flat_xy = x + new_data.size.x * y;
-                int old_index = refl.layers[la][flat_xy], new_index;
-                if (old_index < 0 || old_index >= int(mapping.size()))
-                    new_index = -1;
-                else
-                    new_index = mapping[old_index];
-                new_data.tiles[flat_xy].*layer_list[la] = new_index;
-            }
+                int flat_xy = pos.x + new_data.size.x * pos.y;
+                for (int la = 0; la < layer_count; la++)
+                {
+                    int old_index = refl.layers[la][flat_xy], new_index;
+                    if (old_index < 0 || old_index >= int(mapping.size()))
+                        new_index = -1;
+                    else
+                        new_index = mapping[old_index];
+                    new_data.tiles[flat_xy].*layer_list[la] = new_index;
+                }
+            });
 
             data = std::move(new_data);
 
             return 1;
         }
+
+        bool FromFileContents(const FileContents &contents)
+        {
+            return std::visit([&](const auto &refl){return FromReflectedData(refl);}, contents.refl);
+        }
+
+        bool LoadFromFile(bool forward_compat = 0)
+        {
+            auto contents = ReadFile(file_name, forward_compat);
+            return contents && FromFileContents(*contents);
+        }
     };
 
     class MapEditor
     {
         bool enabled = 0;
+        Utils::FileWatcher::Handle tiling_watch; // Copies of the editor get null handles, and register their own callbacks.
+        std::shared_ptr<bool> tiling_changed; // Set by the callback. The callback doesn't refer to the editor itself, since the editor can be moved with its scene.
+        std::string status_text; // Rebuilt every frame, kept here to reuse the memory.
         ivec2 editor_cam_pos = ivec2(0);
 
         enum class OtherLayersHandling {show, transparent, hide};
@@ -1671,14 +2071,72 @@ namespace Objects
             else
                 ShowMessage(Str("\3Map \1", map.FileName(), "\3 couldn't be saved", (forward_compat ? " \4(compatibility mode)" : "")));
         }
-        void LoadMap(const Scene &scene, bool forward_compat = 0)
+        void LoadMap(const Scene &scene, bool forward_compat = 0) // The file is decoded in the background.
         {
-            auto &map = scene.Get<Map>();
-            bool ok = map.LoadFromFile(forward_compat);
-            if (ok)
-                ShowMessage(Str("\2Map \1", map.FileName(), "\2 was successfully loaded", (forward_compat ? " \4(compatibility mode)" : "")));
-            else
-                ShowMessage(Str("\3Map \1", map.FileName(), "\3 couldn't be loaded", (forward_compat ? " \4(compatibility mode)" : "")));
+            loader.Load([name = scene.Get<Map>().FileName(), forward_compat]{return Map::ReadFile(name, forward_compat);},
+            [this, &scene, forward_compat](std::optional<Map::FileContents> &&contents)
+            {
+                auto &map = scene.Get<Map>();
+                bool ok = contents && map.FromFileContents(*contents);
+                if (ok)
+                    ShowMessage(Str("\2Map \1", map.FileName(), "\2 was successfully loaded", (forward_compat ? " \4(compatibility mode)" : "")));
+                else
+                    ShowMessage(Str("\3Map \1", map.FileName(), "\3 couldn't be loaded", (forward_compat ? " \4(compatibility mode)" : "")));
+            });
+        }
+        void ReloadTiling(const Scene &scene) // The settings are parsed in the background. Then the map is converted to the new tile ids in memory.
+        {
+            struct Result
+            {
+                std::optional<Map::Tiling::Data> data;
+                std::string error;
+            };
+
+            loader.Load([name = Map::tiling.FileName()]
+            {
+                Result ret;
+                try
+                {
+                    ret.data = Map::Tiling::Parse(name);
+                }
+                catch (std::runtime_error &e)
+                {
+                    ret.error = e.what();
+                }
+                return ret;
+            },
+            [this, &scene](Result &&result)
+            {
+                if (!result.data)
+                {
+                    UI::MessageBox("Error!", result.error, UI::warning);
+                    return;
+                }
+
+                auto &map = scene.Get<Map>();
+                auto changed_tiles = Map::tiling.ChangedTiles(*result.data);
+                Map::ReflectedData refl = map.ToReflectedData(); // This uses the old tile ids.
+                Map::tiling.SetData(std::move(*result.data));
+                if (!map.FromReflectedData(refl))
+                {
+                    ShowMessage("\3Tiling settings were reloaded, but the map couldn't be converted");
+                    return;
+                }
+
+                // Autotiling only depends on which tiles are where, so only the cells with changed tiles need to be updated.
+                if (changed_tiles)
+                {
+                    std::vector<bool> tile_mask(Map::tiling.TileCount());
+                    for (int i = 0; i < Map::tiling.TileCount(); i++)
+                        tile_mask[i] = changed_tiles->count(Map::tiling.TileByIndex(i).name);
+                    map.RunAutotilerForTiles(tile_mask);
+                }
+                else
+                {
+                    map.RunAutotilerForEntireMap();
+                }
+                ShowMessage("\2Tiling settings were reloaded");
+            });
         }
 
       public:
@@ -1701,6 +2159,19 @@ namespace Objects
                     SaveMap(scene);
             }
 
+            { // Reload tiling settings when the file changes
+                if (!tiling_watch)
+                {
+                    tiling_changed = std::make_shared<bool>(0);
+                    tiling_watch = file_watcher.Watch(Map::tiling.FileName(), [changed = tiling_changed]{*changed = 1;});
+                }
+                if (*tiling_changed)
+                {
+                    *tiling_changed = 0;
+                    ReloadTiling(scene);
+                }
+            }
+
             { // Timers
                 if (message_alpha > 0)
                 {
@@ -1745,8 +2216,7 @@ namespace Objects
                 {
                     Draw::ReloadTextures();
                     SaveMap(scene);
-                    Map::tiling.Reload();
-                    LoadMap(scene);
+                    ReloadTiling(scene);
                 }
             }
 
@@ -2002,16 +2472,18 @@ namespace Objects
                     // Bottom left
                     ivec2 cam_pos = div_ex(cam.pos, tile_size),
                           pos = (map_interface.Grabbed() ? map_interface.grab_offset : mouse_pos);
-                    std::string bottom_left = Str("Map size: [", std::setw(5), map.Size().x, ",", std::setw(5), map.Size().y, "]",
-                                                  "     Camera center: [", std::setw(5), cam_pos.x, ",", std::setw(5), cam_pos.y, "]",
-                                                  "          Pos: [", std::setw(5), pos.x, ",", std::setw(5), pos.y, "]");
+                    std::string &bottom_left = status_text;
+                    bottom_left.clear();
+                    StrAppend(bottom_left, "Map size: [", std::setw(5), map.Size().x, ",", std::setw(5), map.Size().y, "]",
+                                           "     Camera center: [", std::setw(5), cam_pos.x, ",", std::setw(5), cam_pos.y, "]",
+                                           "          Pos: [", std::setw(5), pos.x, ",", std::setw(5), pos.y, "]");
                     ivec2 size(0);
                     if (map_interface.Grabbed())
                         size = map_interface.GrabbedSize();
                     else if (map_selection_button_down && map_selection_multiple_tiles)
                         size = abs(map_selection_end - map_selection_start) + 1;
                     if (size != ivec2(0))
-                        bottom_left += Str("          Size: [", std::setw(3), size.x, ",", std::setw(3), size.y, "]");
+                        StrAppend(bottom_left, "          Size: [", std::setw(3), size.x, ",", std::setw(3), size.y, "]");
 
                     // Bottom right
                     std::string bottom_right;
@@ -2176,17 +2648,30 @@ namespace Objects
     };
 
 
-    class TestObject
+    class TestObject // Bounces around the screen. It's a part of the simulation, so it only touches its own state when ticking.
     {
         std::string str = "Hello, world!";
+        fvec2 pos = fvec2(0), prev_pos = fvec2(0), vel = fvec2(1.5, 1); // Pixels per tick.
       public:
-        void Tick(const Scene &scene)
+        void Tick(const Scene &simulation)
         {
-            (void)scene;
+            (void)simulation;
+            constexpr fvec2 bounds = screen_sz / 2 - ivec2(48, 8);
+
+            prev_pos = pos;
+            pos += vel;
+            for (int i = 0; i < 2; i++)
+            {
+                if (std::abs(pos[i]) > bounds[i])
+                {
+                    pos[i] = clamp(pos[i], -bounds[i], bounds[i]);
+                    vel[i] = -vel[i];
+                }
+            }
         }
-        void Render(const Scene &scene)
+        void Render(float time) const // `time` is how far we are from the previous tick to the current one.
         {
-            (void)scene;
+            r.Text(prev_pos + (pos - prev_pos) * time, str).preset(Draw::WithBlackOutline);
         }
     };
 }
@@ -2198,6 +2683,7 @@ namespace Scenes
     const Scene game = []
     {
         bool map_editor = 1;
+        bool threaded_simulation = 0;
 
         Scene s;
         s.Add<Camera>(ivec2(0));
@@ -2206,7 +2692,12 @@ namespace Scenes
         if (map_editor) s.Add<MapEditor>();
         s.Add<MapRenderer>();
 
-        s.Add<TestObject>();
+        s.Simulation().Add<TestObject>();
+        s.Simulation().SetTick([](const Scene &s)
+        {
+            s.Get<TestObject>().Tick(s);
+        });
+        s.SetThreadedSimulation(threaded_simulation);
 
         s.Get<Camera>().pos = s.Get<Map>().Size() * tile_size / 2;
         if (map_editor) s.Get<MapEditor>().Enable(s);
@@ -2215,10 +2706,8 @@ namespace Scenes
         {
             s.Get<Background>().Tick();
             if (auto ptr = s.GetOpt<MapEditor>()) ptr->Tick(s);
-
-            s.Get<TestObject>().Tick(s);
         });
-        s.SetRender([](const Scene &s)
+        s.SetRender([](const Scene &s, const Scene &simulation, float time)
         {
             s.Get<Background>().Render();
             s.Get<MapRenderer>().Render(s, Map::back);
@@ -2226,7 +2715,7 @@ namespace Scenes
             s.Get<MapRenderer>().Render(s, Map::front);
             if (auto ptr = s.GetOpt<MapEditor>()) ptr->Render(s);
 
-            s.Get<TestObject>().Render(s);
+            simulation.Get<TestObject>().Render(time);
         });
         return s;
     }();
@@ -2238,6 +2727,10 @@ int main(int, char **)
 {
     Draw::Init();
 
+    // Used if the scene wants its simulation on a separate thread. Events and everything else in the scene are still ticked here.
+    Timing::SimulationThread<Scene> simulation_thread;
+    Scene simulation_snapshot;
+
     auto Tick = [&]
     {
         current_scene.Tick();
@@ -2245,7 +2738,15 @@ int main(int, char **)
     auto Render = [&]
     {
         Graphics::Clear(Graphics::color);
-        current_scene.Render();
+        if (simulation_thread.Exists())
+        {
+            float time = simulation_thread.Fetch(simulation_snapshot); // The objects remember their previous state themselves, so the older snapshot isn't needed.
+            current_scene.Render(simulation_snapshot, time);
+        }
+        else
+        {
+            current_scene.Render(tick_stabilizer.Time());
+        }
     };
 
     uint64_t frame_start = Timing::Clock(), frame_delta;
@@ -2256,6 +2757,26 @@ int main(int, char **)
         frame_delta = time - frame_start;
         frame_start = time;
 
+        file_watcher.Tick();
+        loader.Tick(Timing::Tpms() * 2); // Applies loaded assets, spending at most ~2 ms per frame.
+
+        if (current_scene.ThreadedSimulation() != simulation_thread.Exists())
+        {
+            if (simulation_thread.Exists())
+            {
+                simulation_thread.Fetch(current_scene.Simulation()); // Continue from where the thread stopped.
+                simulation_thread.Destroy();
+            }
+            else
+            {
+                simulation_thread.Create(ticks_per_second, [simulation = current_scene.Simulation()](Scene &snapshot) mutable
+                {
+                    simulation.Tick();
+                    snapshot = simulation;
+                }, current_scene.Simulation());
+            }
+        }
+
         while (tick_stabilizer.Tick(frame_delta))
         {
             Events::Process();
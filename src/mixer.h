@@ -0,0 +1,373 @@
+#ifndef MIXER_H_INCLUDED
+#define MIXER_H_INCLUDED
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+#include "audio.h"
+#include "program.h"
+
+namespace Audio
+{
+    /* Mixes any amount of voices in software into one stereo 16-bit stream, so they don't use OpenAL sources.
+     * The output can be played with `Stream(mixer.Provider(), Sound::stereo16, mixer.Frequency())`, or rendered to a `Sound` with `Render()`.
+     * All functions are thread-safe, since the stream calls `Mix()` on its own thread.
+     */
+    class Mixer
+    {
+      public:
+        class Clip // Sound data in the format used by the mixer: interleaved floats in -1..1, at any frequency.
+        {
+            std::vector<float> samples;
+            int channels = 1, freq = 44100;
+
+          public:
+            Clip() {}
+            Clip(const Sound &sound)
+            {
+                channels = sound.Stereo() ? 2 : 1;
+                freq = sound.Frequency();
+                std::size_t count = sound.Samples() * channels;
+                samples.resize(count);
+                if (sound.Bits8())
+                {
+                    for (std::size_t i = 0; i < count; i++)
+                        samples[i] = (int(sound.Data()[i]) - 128) / 128.f;
+                }
+                else
+                {
+                    for (std::size_t i = 0; i < count; i++)
+                    {
+                        int16_t value;
+                        std::memcpy(&value, sound.Data() + i * 2, 2);
+                        samples[i] = value / 32768.f;
+                    }
+                }
+            }
+
+            [[nodiscard]] const float *Data() const {return samples.data();}
+            [[nodiscard]] std::size_t Frames() const {return samples.size() / channels;}
+            [[nodiscard]] int Channels() const {return channels;}
+            [[nodiscard]] int Frequency() const {return freq;}
+        };
+
+        struct VoiceParams
+        {
+            float gain = 1;
+            float pan = 0; // -1 is left, 1 is right. For stereo clips this is the balance.
+            float pitch = 1; // Changes the playback speed, with linear interpolation.
+            bool loop = 0;
+        };
+
+        class Voice // A handle for a playing voice. It becomes invalid when the voice stops.
+        {
+            friend class Mixer;
+            uint32_t index = -1, generation = 0;
+          public:
+            Voice() {}
+        };
+
+      private:
+        static constexpr int frac_bits = 32; // Positions in clips are fixed-point.
+
+        struct VoiceData
+        {
+            std::shared_ptr<const Clip> clip;
+            VoiceParams params;
+            uint64_t pos = 0, step = 0;
+            uint32_t generation = 0;
+            bool active = 0;
+        };
+
+        int freq;
+        std::vector<VoiceData> voices;
+        std::vector<uint32_t> free_voices;
+        int active_count = 0;
+        std::vector<float> acc; // Interleaved stereo accumulator.
+        mutable std::mutex mutex;
+
+        uint64_t Step(const VoiceData &voice) const
+        {
+            return std::llround(double(voice.params.pitch) * voice.clip->Frequency() / freq * (uint64_t(1) << frac_bits));
+        }
+
+        bool Valid(Voice voice) const
+        {
+            return voice.index < voices.size() && voices[voice.index].active && voices[voice.index].generation == voice.generation;
+        }
+        VoiceData *Find(Voice voice)
+        {
+            return Valid(voice) ? &voices[voice.index] : 0;
+        }
+
+        void Release(uint32_t index)
+        {
+            voices[index].active = 0;
+            voices[index].clip = 0;
+            voices[index].generation++;
+            free_voices.push_back(index);
+            active_count--;
+        }
+
+        // Adds `frames` frames of the voice to `dst` (interleaved stereo). Returns 0 if the voice has finished.
+        static bool MixVoice(float *dst, std::size_t frames, VoiceData &voice)
+        {
+            const Clip &clip = *voice.clip;
+            const float *src = clip.Data();
+            const std::size_t len = clip.Frames();
+            const uint64_t end = uint64_t(len) << frac_bits, step = voice.step;
+            if (len == 0 || step == 0)
+                return 0;
+
+            float gain_l = voice.params.gain * std::min(1.f, 1 - voice.params.pan),
+                  gain_r = voice.params.gain * std::min(1.f, 1 + voice.params.pan);
+            const float frac_factor = 1.f / float(uint64_t(1) << frac_bits);
+            uint64_t pos = voice.pos;
+            std::size_t i = 0;
+
+            // Reads a frame with linear interpolation, wrapping to the beginning if needed. Used at the edges of the clip.
+            auto Sample = [&](std::size_t index, int channel) -> float
+            {
+                if (index >= len)
+                {
+                    if (!voice.params.loop)
+                        return 0;
+                    index -= len;
+                }
+                return src[index * clip.Channels() + channel];
+            };
+
+            while (i < frames)
+            {
+                if (pos >= end)
+                {
+                    if (!voice.params.loop)
+                        return 0;
+                    pos %= end;
+                }
+
+                #ifdef __SSE2__
+                // The vectorized loops only run while all frames they touch (including the next one, for interpolation) are inside the clip.
+                if (clip.Channels() == 1)
+                {
+                    __m128 vgain_l = _mm_set1_ps(gain_l), vgain_r = _mm_set1_ps(gain_r);
+                    if (step == uint64_t(1) << frac_bits && (pos & ((uint64_t(1) << frac_bits) - 1)) == 0)
+                    {
+                        // No resampling, the samples are loaded directly.
+                        while (frames - i >= 4 && (pos >> frac_bits) + 4 <= len)
+                        {
+                            __m128 s = _mm_loadu_ps(src + (pos >> frac_bits));
+                            __m128 l = _mm_mul_ps(s, vgain_l), r = _mm_mul_ps(s, vgain_r);
+                            _mm_storeu_ps(dst + i*2, _mm_add_ps(_mm_loadu_ps(dst + i*2), _mm_unpacklo_ps(l, r)));
+                            _mm_storeu_ps(dst + i*2 + 4, _mm_add_ps(_mm_loadu_ps(dst + i*2 + 4), _mm_unpackhi_ps(l, r)));
+                            i += 4;
+                            pos += step * 4;
+                        }
+                    }
+                    else
+                    {
+                        while (frames - i >= 4 && ((pos + step * 3) >> frac_bits) + 1 < len)
+                        {
+                            alignas(16) float a[4], b[4], f[4];
+                            for (int j = 0; j < 4; j++)
+                            {
+                                std::size_t index = pos >> frac_bits;
+                                a[j] = src[index];
+                                b[j] = src[index + 1];
+                                f[j] = (pos & ((uint64_t(1) << frac_bits) - 1)) * frac_factor;
+                                pos += step;
+                            }
+                            __m128 va = _mm_load_ps(a);
+                            __m128 s = _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b), va), _mm_load_ps(f)));
+                            __m128 l = _mm_mul_ps(s, vgain_l), r = _mm_mul_ps(s, vgain_r);
+                            _mm_storeu_ps(dst + i*2, _mm_add_ps(_mm_loadu_ps(dst + i*2), _mm_unpacklo_ps(l, r)));
+                            _mm_storeu_ps(dst + i*2 + 4, _mm_add_ps(_mm_loadu_ps(dst + i*2 + 4), _mm_unpackhi_ps(l, r)));
+                            i += 4;
+                        }
+                    }
+                }
+                else
+                {
+                    __m128 vgain = _mm_setr_ps(gain_l, gain_r, gain_l, gain_r);
+                    while (frames - i >= 2 && ((pos + step) >> frac_bits) + 1 < len)
+                    {
+                        std::size_t index0 = pos >> frac_bits, index1 = (pos + step) >> frac_bits;
+                        float f0 = (pos & ((uint64_t(1) << frac_bits) - 1)) * frac_factor,
+                              f1 = ((pos + step) & ((uint64_t(1) << frac_bits) - 1)) * frac_factor;
+                        __m128 va = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)(src + index0 * 2)), (const __m64 *)(src + index1 * 2));
+                        __m128 vb = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)(src + index0 * 2 + 2)), (const __m64 *)(src + index1 * 2 + 2));
+                        __m128 s = _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), _mm_setr_ps(f0, f0, f1, f1)));
+                        _mm_storeu_ps(dst + i*2, _mm_add_ps(_mm_loadu_ps(dst + i*2), _mm_mul_ps(s, vgain)));
+                        i += 2;
+                        pos += step * 2;
+                    }
+                }
+                if (i >= frames)
+                    break;
+                #endif
+
+                // One frame at a time. Without SSE2 this does all the work.
+                std::size_t index = pos >> frac_bits;
+                float f = (pos & ((uint64_t(1) << frac_bits) - 1)) * frac_factor;
+                if (clip.Channels() == 1)
+                {
+                    float a = Sample(index, 0), s = a + (Sample(index + 1, 0) - a) * f;
+                    dst[i*2] += s * gain_l;
+                    dst[i*2+1] += s * gain_r;
+                }
+                else
+                {
+                    float a = Sample(index, 0), b = Sample(index, 1);
+                    dst[i*2] += (a + (Sample(index + 1, 0) - a) * f) * gain_l;
+                    dst[i*2+1] += (b + (Sample(index + 1, 1) - b) * f) * gain_r;
+                }
+                i++;
+                pos += step;
+            }
+
+            voice.pos = pos;
+            return 1;
+        }
+
+      public:
+        Mixer(int freq = 44100) : freq(freq) {}
+
+        Mixer(const Mixer &) = delete;
+        Mixer &operator=(const Mixer &) = delete;
+
+        [[nodiscard]] int Frequency() const
+        {
+            return freq;
+        }
+
+        Voice Play(std::shared_ptr<const Clip> clip) // A separate overload, since `VoiceParams{}` can't be a default argument inside of the class.
+        {
+            return Play(std::move(clip), VoiceParams{});
+        }
+        Voice Play(std::shared_ptr<const Clip> clip, VoiceParams params)
+        {
+            DebugAssert("Attempt to play a null clip.", clip);
+            std::lock_guard lock(mutex);
+
+            uint32_t index;
+            if (free_voices.size())
+            {
+                index = free_voices.back();
+                free_voices.pop_back();
+            }
+            else
+            {
+                index = voices.size();
+                voices.emplace_back();
+            }
+
+            VoiceData &voice = voices[index];
+            voice.clip = std::move(clip);
+            voice.params = params;
+            voice.pos = 0;
+            voice.step = Step(voice);
+            voice.active = 1;
+            active_count++;
+
+            Voice ret;
+            ret.index = index;
+            ret.generation = voice.generation;
+            return ret;
+        }
+
+        void Stop(Voice voice)
+        {
+            std::lock_guard lock(mutex);
+            if (Find(voice))
+                Release(voice.index);
+        }
+        void StopAll()
+        {
+            std::lock_guard lock(mutex);
+            for (uint32_t i = 0; i < voices.size(); i++)
+                if (voices[i].active)
+                    Release(i);
+        }
+
+        [[nodiscard]] bool IsPlaying(Voice voice) const
+        {
+            std::lock_guard lock(mutex);
+            return Valid(voice);
+        }
+        void SetParams(Voice voice, VoiceParams params) // Does nothing if the voice has stopped.
+        {
+            std::lock_guard lock(mutex);
+            if (VoiceData *data = Find(voice))
+            {
+                data->params = params;
+                data->step = Step(*data);
+            }
+        }
+
+        [[nodiscard]] int ActiveVoices() const
+        {
+            std::lock_guard lock(mutex);
+            return active_count;
+        }
+
+        void Mix(int16_t *dst, std::size_t frames) // Writes interleaved stereo samples. Finished voices are removed.
+        {
+            std::lock_guard lock(mutex);
+
+            acc.assign(frames * 2, 0);
+            for (uint32_t i = 0; i < voices.size(); i++)
+            {
+                if (voices[i].active && !MixVoice(acc.data(), frames, voices[i]))
+                    Release(i);
+            }
+
+            std::size_t i = 0;
+            #ifdef __SSE2__
+            __m128 scale = _mm_set1_ps(32767);
+            for (; i + 8 <= frames * 2; i += 8)
+            {
+                // `_mm_packs_epi32` saturates, so clipping is free.
+                __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(acc.data() + i), scale));
+                __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(acc.data() + i + 4), scale));
+                _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(a, b));
+            }
+            #endif
+            for (; i < frames * 2; i++)
+                dst[i] = std::lround(std::clamp(acc[i], -1.f, 1.f) * 32767);
+        }
+
+        [[nodiscard]] Stream::provider_t Provider() // Returns a provider for `Stream`, which should use the `stereo16` format. The mixer must outlive the stream.
+        {
+            return [this, buffer = std::vector<int16_t>()](uint8_t *dst, std::size_t len) mutable -> std::size_t
+            {
+                std::size_t frames = len / 4;
+                buffer.resize(frames * 2);
+                Mix(buffer.data(), frames);
+                std::memcpy(dst, buffer.data(), frames * 4);
+                return len; // The mixer never ends, it plays silence when there are no voices.
+            };
+        }
+
+        [[nodiscard]] Sound Render(std::size_t frames) // Mixes into a new sound, e.g. to save it with `Sound::SaveWAV()`.
+        {
+            Sound ret;
+            ret.FromMemory(Sound::stereo16, freq, frames);
+            std::vector<int16_t> buffer(frames * 2);
+            Mix(buffer.data(), frames);
+            std::memcpy(ret.Data(), buffer.data(), frames * 4);
+            return ret;
+        }
+    };
+}
+
+#endif
@@ -3,12 +3,17 @@
 
 #include <algorithm>
 #include <bitset>
+#include <charconv>
 #include <cctype>
 #include <cstddef>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <iterator>
+#include <limits>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <unordered_map>
 #include <utility>
@@ -231,8 +236,209 @@ namespace Reflection
             static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "T must be arithmetic or an enum.");
             fix_order((uint8_t *)&value, (uint8_t *)(&value + 1));
         }
+        template <typename T> void fix_order_array([[maybe_unused]] void *ptr, [[maybe_unused]] std::size_t count) // Fixes `count` consecutive values of type `T`. The pointer doesn't have to be aligned.
+        {
+            static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "T must be arithmetic or an enum.");
+            #ifdef REFLECTION_NONNATIVE_ENDIANNESS
+            uint8_t *bytes = (uint8_t *)ptr;
+            for (std::size_t i = 0; i < count; i++) // A simple loop, so that the compiler can vectorize it.
+            {
+                T value;
+                std::memcpy(&value, bytes + i * sizeof(T), sizeof(T));
+                fix_order(value);
+                std::memcpy(bytes + i * sizeof(T), &value, sizeof(T));
+            }
+            #endif
+        }
+        template <typename T> void copy_fixing_order(void *dst, const void *src, std::size_t count) // Same as `memcpy` followed by `fix_order_array`, but in a single pass. The ranges must not overlap.
+        {
+            static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "T must be arithmetic or an enum.");
+            #ifdef REFLECTION_NONNATIVE_ENDIANNESS
+            for (std::size_t i = 0; i < count; i++)
+            {
+                T value;
+                std::memcpy(&value, (const uint8_t *)src + i * sizeof(T), sizeof(T));
+                fix_order(value);
+                std::memcpy((uint8_t *)dst + i * sizeof(T), &value, sizeof(T));
+            }
+            #else
+            std::memcpy(dst, src, count * sizeof(T));
+            #endif
+        }
+
+        /* A source of bytes for `from_bytes()`, that doesn't need the whole input to be in memory at once.
+         * The data comes in chunks from a callback: `bool next_chunk(const uint8_t *&begin, const uint8_t *&end)`.
+         * It should point `begin` and `end` to the next chunk and return 1, or return 0 when there is no more data.
+         * A chunk has to stay valid until the next call to the callback.
+         */
+        class Reader
+        {
+            const uint8_t *pos = 0, *end = 0;
+            std::function<bool(const uint8_t *&, const uint8_t *&)> next_chunk;
+            bool finished = 0;
+
+            bool refill() // Returns 0 if there is no more data.
+            {
+                while (pos == end)
+                {
+                    if (finished || !next_chunk || !next_chunk(pos, end))
+                    {
+                        finished = 1;
+                        pos = end = 0;
+                        return 0;
+                    }
+                }
+                return 1;
+            }
+
+          public:
+            Reader() {}
+            Reader(const uint8_t *begin, const uint8_t *end) : pos(begin), end(end) {}
+            Reader(std::function<bool(const uint8_t *&, const uint8_t *&)> next_chunk) : next_chunk(std::move(next_chunk)) {}
+
+            [[nodiscard]] bool read(void *dst, std::size_t len) // Returns 0 if there is not enough data. In this case the contents of `dst` are unspecified.
+            {
+                uint8_t *ptr = (uint8_t *)dst;
+                while (len > 0)
+                {
+                    if (!refill())
+                        return 0;
+                    std::size_t segment = std::min(len, std::size_t(end - pos));
+                    std::memcpy(ptr, pos, segment);
+                    ptr += segment;
+                    pos += segment;
+                    len -= segment;
+                }
+                return 1;
+            }
+
+            [[nodiscard]] bool at_end() // Note that this can request a new chunk.
+            {
+                return !refill();
+            }
+        };
     }
 
+    /* A read-only view of an array of arithmetic values or enums, stored in the binary format.
+     * `from_bytes()` makes it point into the source buffer instead of copying the data. The buffer must outlive the view.
+     * The elements are decoded on access, so the underlying bytes don't have to be aligned.
+     * Serialized exactly like `std::vector<T>`, so one can be read as another.
+     */
+    template <typename T> class ArrayView
+    {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "T must be arithmetic or an enum.");
+
+        const uint8_t *bytes = 0;
+        std::size_t count = 0;
+
+      public:
+        ArrayView() {}
+        ArrayView(const uint8_t *bytes, std::size_t count) : bytes(bytes), count(count) {}
+
+        [[nodiscard]] std::size_t size() const {return count;}
+        [[nodiscard]] bool empty() const {return count == 0;}
+        [[nodiscard]] const uint8_t *data() const {return bytes;} // Returns the raw bytes, there are `size() * sizeof(T)` of them.
+
+        [[nodiscard]] T operator[](std::size_t index) const
+        {
+            T ret;
+            std::memcpy(&ret, bytes + index * sizeof(T), sizeof(T));
+            Bytes::fix_order(ret);
+            return ret;
+        }
+
+        void copy_to(T *dst) const // Copies all elements to `dst`.
+        {
+            if (count > 0)
+                Bytes::copy_fixing_order<T>(dst, bytes, count);
+        }
+    };
+
+    /* Collects the text produced by `write_string()`.
+     * If a file is given, the text is flushed to it in large blocks. Otherwise it accumulates in `str()`.
+     * There is no shared state, so different threads can use different writers at the same time.
+     */
+    class Writer
+    {
+        std::string buffer;
+        std::FILE *file = 0;
+        bool failed = 0;
+
+        void maybe_flush()
+        {
+            if (file && buffer.size() >= flush_threshold)
+                flush();
+        }
+
+      public:
+        inline static constexpr std::size_t flush_threshold = 0x10000;
+
+        Writer() {}
+        Writer(std::FILE *file) : file(file) // The file is not closed by the writer.
+        {
+            buffer.reserve(flush_threshold * 2);
+        }
+
+        Writer(const Writer &) = delete;
+        Writer &operator=(const Writer &) = delete;
+
+        ~Writer()
+        {
+            flush();
+        }
+
+        void put(char ch)
+        {
+            buffer += ch;
+            maybe_flush();
+        }
+        void put(std::string_view str)
+        {
+            buffer += str;
+            maybe_flush();
+        }
+        template <typename T> void put_number(T value) // Same output as `Math::num_to_string<T>()` with the default settings.
+        {
+            static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, "T must be arithmetic.");
+            char tmp[64];
+            std::to_chars_result result;
+            if constexpr (std::is_integral_v<T>)
+            {
+                result = std::to_chars(tmp, tmp + sizeof tmp, value);
+            }
+            else
+            {
+                #if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611
+                result = std::to_chars(tmp, tmp + sizeof tmp, value, std::chars_format::general, 6); // Same as `%g`.
+                #else
+                put(Math::num_to_string<T>(value));
+                return;
+                #endif
+            }
+            put(std::string_view(tmp, result.ptr - tmp));
+        }
+
+        bool flush() // Returns 0 if writing to the file has failed at any point.
+        {
+            if (file && buffer.size() > 0)
+            {
+                if (std::fwrite(buffer.data(), buffer.size(), 1, file) != 1)
+                    failed = 1;
+                buffer.clear();
+            }
+            return !failed;
+        }
+
+        [[nodiscard]] std::string &str() // The text written so far. If there is a file, only the part that wasn't flushed yet.
+        {
+            return buffer;
+        }
+        void clear() // Keeps the capacity, so the writer can be reused.
+        {
+            buffer.clear();
+        }
+    };
+
     namespace Cexpr
     {
         // Utils
@@ -328,7 +534,7 @@ namespace Reflection
         template <typename F, typename ...P> using last_of = typename last_of_impl<F, P...>::type;
 
 
-        template <typename T> inline constexpr bool forced_primitive = std::is_same_v<std::string, T>;
+        template <typename T> inline constexpr bool forced_primitive = std::is_same_v<std::string, T> || std::is_same_v<std::string_view, T>;
 
 
         // Default interface functions
@@ -349,11 +555,14 @@ namespace Reflection
 
         // Should be used for primitives only.
         inline std::string reflection_interface_primitive_to_string(const void *) noexcept {return "??";}
+        inline void reflection_interface_primitive_write_string(const void *, Writer &) noexcept {} // Optional, a faster alternative to `reflection_interface_primitive_to_string`. Should produce the same text.
         inline std::size_t reflection_interface_primitive_from_string(void *, const char *) = delete; // Returns a number of chars consumed or 0 if the conversion has failed (in this case the object is left unchanged).
 
         inline std::size_t reflection_interface_primitive_byte_buffer_size(const void *) = delete; // Returns the amount of bytes needed to store an object.
+        inline constexpr std::size_t reflection_interface_primitive_fixed_byte_size(const void *) noexcept {return 0;} // Optional. If all objects of a type need the same amount of bytes, this should return it. 0 means that the size varies.
         inline uint8_t *reflection_interface_primitive_to_bytes(const void *, uint8_t *buf) = delete; // Returns the pointer to the next free byte in the buffer.
         inline const uint8_t *reflection_interface_primitive_from_bytes(void *, const uint8_t *buf, const uint8_t *buf_end) = delete; // Returns a pointer to the next byte in the buffer or 0 on failure.
+        inline bool reflection_interface_primitive_from_reader(void *, Bytes::Reader &reader) = delete; // Same as above, but for streams. Returns 0 on failure.
 
         // Should be used for composites only and return a short single-line summary of contents. Optional.
         inline std::string reflection_interface_composite_summary_string(const void *) noexcept {return "...";}
@@ -369,6 +578,10 @@ namespace Reflection
         inline void/*iterator*/ reflection_interface_container_insert_move(void *, sink/*const const_iterator? &iterator*/, sink/*decltype(*std::begin(T(...))) &&value*/) noexcept;
         // This should return an iterator to the next valid element.
         inline void/*iterator*/ reflection_interface_container_erase(void *, sink/*const const_iterator? &begin_iterator*/, sink/*const const_iterator? &end_iterator*/) noexcept;
+        // Optional. If a container stores arithmetic values (not `bool`s) or enums contiguously, these let it be (de)serialized with a single `memcpy`.
+        // `data` should return a pointer to the first element, and `resize` should change the element count. Either both or none of them should be provided.
+        inline void reflection_interface_container_data(const void *) noexcept {}
+        inline void reflection_interface_container_resize(void *, std::size_t) noexcept {}
 
         template <typename T> std::enable_if_t<std::is_enum_v<T>, const std::unordered_map<std::string, T> &> reflection_interface_enum_string_value_map(const T *) {static std::unordered_map<std::string, T> ret; return ret;} // No noexcept here.
         template <typename T> std::enable_if_t<std::is_enum_v<T>, const std::unordered_map<T, std::string> &> reflection_interface_enum_value_string_map(const T *) {static std::unordered_map<T, std::string> ret; return ret;} // No noexcept here.
@@ -381,6 +594,23 @@ namespace Reflection
         {
             return Strings::add_quotes(*obj);
         }
+        inline void reflection_interface_primitive_write_string(const std::string *obj, Writer &writer)
+        {
+            writer.put('"');
+            const char *begin = obj->data(), *end = begin + obj->size();
+            while (begin != end)
+            {
+                // Writing the characters that don't need escaping in blocks.
+                const char *block_end = begin;
+                while (block_end != end && Strings::char_escape_len(*block_end) == 1)
+                    block_end++;
+                writer.put(std::string_view(begin, block_end - begin));
+                if (block_end != end)
+                    writer.put(Strings::char_escape_seq(*block_end++));
+                begin = block_end;
+            }
+            writer.put('"');
+        }
         inline std::size_t reflection_interface_primitive_from_string(std::string *obj, const char *str)
         {
             std::size_t chars_consumed;
@@ -421,48 +651,159 @@ namespace Reflection
                 obj->push_back(*buf++);
             return buf;
         }
+        // String views. They can only be read from buffers, and they point into them.
+        inline std::size_t reflection_interface_primitive_byte_buffer_size(const std::string_view *obj)
+        {
+            return 4 + obj->size();
+        }
+        inline uint8_t *reflection_interface_primitive_to_bytes(const std::string_view *obj, uint8_t *buf)
+        {
+            uint32_t len = obj->size();
+            Bytes::fix_order(len);
+            std::memcpy(buf, &len, sizeof len);
+            buf += sizeof len;
+            std::memcpy(buf, obj->data(), obj->size());
+            buf += obj->size();
+            return buf;
+        }
+        inline const uint8_t *reflection_interface_primitive_from_bytes(std::string_view *obj, const uint8_t *buf, const uint8_t *buf_end)
+        {
+            if (buf_end - buf < 4)
+                return 0;
+            uint32_t len;
+            std::memcpy(&len, buf, sizeof len);
+            Bytes::fix_order(len);
+            buf += sizeof len;
+
+            if (buf_end - buf < std::ptrdiff_t(len))
+                return 0;
+            *obj = std::string_view((const char *)buf, len);
+            return buf + len;
+        }
+
+        inline bool reflection_interface_primitive_from_reader(std::string *obj, Bytes::Reader &reader)
+        {
+            uint32_t len;
+            if (!reader.read(&len, sizeof len))
+                return 0;
+            Bytes::fix_order(len);
+
+            // Reading in pieces, to avoid allocating a lot of memory if the length is broken.
+            constexpr std::size_t piece = 0x10000;
+            obj->clear();
+            while (len > 0)
+            {
+                std::size_t segment = std::min(std::size_t(len), piece), old_size = obj->size();
+                obj->resize(old_size + segment);
+                if (!reader.read(obj->data() + old_size, segment))
+                    return 0;
+                len -= segment;
+            }
+            return 1;
+        }
 
         // Arithmetic types
         template <typename T> std::enable_if_t<std::is_arithmetic_v<T>, std::string> reflection_interface_primitive_to_string(const T *obj) {return Math::num_to_string<T>(*obj);}
         inline std::string reflection_interface_primitive_to_string(const bool *obj) {return (*obj ? "true" : "false");}
+        template <typename T> std::enable_if_t<std::is_arithmetic_v<T>> reflection_interface_primitive_write_string(const T *obj, Writer &writer) {writer.put_number(*obj);}
+        inline void reflection_interface_primitive_write_string(const bool *obj, Writer &writer) {writer.put(*obj ? "true" : "false");}
 
         template <typename T> std::enable_if_t<std::is_arithmetic_v<T>, std::size_t> reflection_interface_primitive_from_string(T *obj, const char *str)
         {
-            if (std::isspace(*str))
-                return 0;
+            // The syntax is the same as for `strto*` with base 0, but locale-independent: optional sign, `0x` for hex, leading `0` for octal.
 
-            T ret;
-            char *end;
+            const char *ptr = str;
+            bool negative = 0;
+            if (*ptr == '-' || *ptr == '+')
+                negative = (*ptr++ == '-');
+
+            bool hex = ptr[0] == '0' && (ptr[1] == 'x' || ptr[1] == 'X');
 
             if constexpr (std::is_integral_v<T>)
             {
-                if constexpr (sizeof (T) <= sizeof (long))
+                int base = 10;
+                if (hex && Strings::is_hex_digit(ptr[2]))
                 {
-                    if constexpr (std::is_signed_v<T>)
-                        ret = std::strtol(str, &end, 0);
-                    else
-                        ret = std::strtoul(str, &end, 0);
+                    base = 16;
+                    ptr += 2;
+                }
+                else if (ptr[0] == '0' && Strings::is_digit(ptr[1]))
+                {
+                    base = 8;
+                }
+
+                // `from_chars` needs to know where the string ends. Scanning for the end of the number is much cheaper than `strlen()`.
+                const char *end = ptr;
+                while (base == 16 ? Strings::is_hex_digit(*end) : Strings::is_digit(*end))
+                    end++;
+
+                using unsigned_t = std::make_unsigned_t<std::conditional_t<(sizeof(T) < sizeof(int)), int, T>>;
+                unsigned_t magnitude;
+                auto [num_end, status] = std::from_chars(ptr, end, magnitude, base);
+                if (status != std::errc{} || num_end == ptr)
+                    return 0;
+
+                T ret;
+                if constexpr (std::is_signed_v<T>)
+                {
+                    unsigned_t limit = unsigned_t(std::numeric_limits<T>::max()) + negative;
+                    if (magnitude > limit)
+                        return 0;
+                    ret = negative ? T(0 - magnitude) : T(magnitude);
                 }
                 else
                 {
-                    if constexpr (std::is_signed_v<T>)
-                        ret = std::strtoll(str, &end, 0);
-                    else
-                        ret = std::strtoull(str, &end, 0);
+                    if (negative || magnitude > std::numeric_limits<T>::max())
+                        return 0;
+                    ret = magnitude;
                 }
+
+                *obj = ret;
+                return num_end - str;
             }
-            else if constexpr (sizeof (T) <= sizeof (float))
-                ret = std::strtof(str, &end);
-            else if constexpr (sizeof (T) <= sizeof (double))
-                ret = std::strtod(str, &end);
             else
-                ret = std::strtold(str, &end);
+            {
+                #if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611
+                if (!hex) // `from_chars` has no hex prefix syntax, so those go to `strto*`.
+                {
+                    // Same trick as above. A float can only contain digits, letters (for exponents, `inf` and `nan`), dots and signs.
+                    const char *end = ptr;
+                    while (Strings::is_alphanum(*end) || *end == '.' || ((*end == '-' || *end == '+') && (end[-1] == 'e' || end[-1] == 'E')))
+                        end++;
+
+                    T ret;
+                    auto [num_end, status] = std::from_chars(ptr, end, ret);
+                    if (status == std::errc{} && num_end != ptr)
+                    {
+                        *obj = negative ? -ret : ret;
+                        return num_end - str;
+                    }
+                    if (status != std::errc::result_out_of_range)
+                        return 0;
+                    // `from_chars` rejects values that are too large or too small, while `strto*` gives infinity or zero (or a denormal) for them.
+                    // Those are rare, so they fall through to `strto*` to keep the old results.
+                }
+                #endif
 
-            if (end == str)
-                return 0;
+                if (std::isspace(*str))
+                    return 0;
+
+                T ret;
+                char *end;
+
+                if constexpr (sizeof (T) <= sizeof (float))
+                    ret = std::strtof(str, &end);
+                else if constexpr (sizeof (T) <= sizeof (double))
+                    ret = std::strtod(str, &end);
+                else
+                    ret = std::strtold(str, &end);
 
-            *obj = ret;
-            return end - str;
+                if (end == str)
+                    return 0;
+
+                *obj = ret;
+                return end - str;
+            }
         }
         inline std::size_t reflection_interface_primitive_from_string(bool *obj, const char *str)
         {
@@ -502,6 +843,7 @@ namespace Reflection
 
         // (these also work for enums)
         template <typename T> std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>, std::size_t> reflection_interface_primitive_byte_buffer_size(const T *) {return sizeof(T);}
+        template <typename T> constexpr std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>, std::size_t> reflection_interface_primitive_fixed_byte_size(const T *) noexcept {return sizeof(T);}
         template <typename T> std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>, uint8_t *> reflection_interface_primitive_to_bytes(const T *obj, uint8_t *buf)
         {
             std::memcpy(buf, obj, sizeof(T));
@@ -516,6 +858,43 @@ namespace Reflection
             Bytes::fix_order(*obj);
             return buf + sizeof(T);
         }
+        template <typename T> std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>, bool> reflection_interface_primitive_from_reader(T *obj, Bytes::Reader &reader)
+        {
+            if (!reader.read(obj, sizeof(T)))
+                return 0;
+            Bytes::fix_order(*obj);
+            return 1;
+        }
+
+        // Array views. Like string views, they can only be read from buffers.
+        template <typename T> std::size_t reflection_interface_primitive_byte_buffer_size(const ArrayView<T> *obj)
+        {
+            return 4 + obj->size() * sizeof(T);
+        }
+        template <typename T> uint8_t *reflection_interface_primitive_to_bytes(const ArrayView<T> *obj, uint8_t *buf)
+        {
+            uint32_t len = obj->size();
+            Bytes::fix_order(len);
+            std::memcpy(buf, &len, sizeof len);
+            buf += sizeof len;
+            if (obj->size() > 0)
+                std::memcpy(buf, obj->data(), obj->size() * sizeof(T)); // The bytes are already in the right order.
+            return buf + obj->size() * sizeof(T);
+        }
+        template <typename T> const uint8_t *reflection_interface_primitive_from_bytes(ArrayView<T> *obj, const uint8_t *buf, const uint8_t *buf_end)
+        {
+            if (buf_end - buf < 4)
+                return 0;
+            uint32_t len;
+            std::memcpy(&len, buf, sizeof len);
+            Bytes::fix_order(len);
+            buf += sizeof len;
+
+            if (std::size_t(buf_end - buf) / sizeof(T) < len)
+                return 0;
+            *obj = ArrayView<T>(buf, len);
+            return buf + len * sizeof(T);
+        }
 
         // Enums
         template <typename T> std::enable_if_t<std::is_enum_v<T>, std::string> reflection_interface_primitive_to_string(const T *obj)
@@ -581,6 +960,10 @@ namespace Reflection
         {
             return S;
         }
+        template <std::size_t S> constexpr std::size_t reflection_interface_primitive_fixed_byte_size(const std::bitset<S> *) noexcept
+        {
+            return S;
+        }
         template <std::size_t S> uint8_t *reflection_interface_primitive_to_bytes(const std::bitset<S> *obj, uint8_t *buf)
         {
             for (std::size_t i = 0; i < S; i++)
@@ -599,6 +982,11 @@ namespace Reflection
             }
             return buf + S;
         }
+        template <std::size_t S> bool reflection_interface_primitive_from_reader(std::bitset<S> *obj, Bytes::Reader &reader)
+        {
+            uint8_t buf[S];
+            return reader.read(buf, S) && reflection_interface_primitive_from_bytes(obj, buf, buf + S);
+        }
 
 
         // Vectors/matrices
@@ -645,6 +1033,11 @@ namespace Reflection
                               reflection_interface_container_insert_move(T *ptr, const impl_std_cont_const_iter_t<T> &iter,       impl_std_cont_value_t<T> &&value) {return ptr->insert(iter, (impl_std_cont_value_t<T> &&) value);}
         template <typename T> std::enable_if_t<!forced_primitive<T>, decltype(std::declval<T &>().erase(std::cbegin(std::declval<const T &>()), std::cbegin/*sic*/(std::declval<const T &>())))>
                               reflection_interface_container_erase      (T *ptr, const impl_std_cont_const_iter_t<T> &begin, const impl_std_cont_const_iter_t<T> &end) {return ptr->erase(begin, end);}
+        /*internal*/ template <typename T> inline constexpr bool impl_std_cont_is_bulk = (std::is_arithmetic_v<impl_std_cont_value_t<T>> && !std::is_same_v<impl_std_cont_value_t<T>, bool>) || std::is_enum_v<impl_std_cont_value_t<T>>;
+        template <typename T> std::enable_if_t<!forced_primitive<T> && impl_std_cont_is_bulk<T>, decltype(std::data(std::declval<const T &>()))>
+                              reflection_interface_container_data  (const T *ptr) {return std::data(*ptr);}
+        template <typename T> std::enable_if_t<!forced_primitive<T> && impl_std_cont_is_bulk<T>, decltype(std::declval<T &>().resize(std::size_t()))>
+                              reflection_interface_container_resize(T *ptr, std::size_t size) {ptr->resize(size);}
 
         class Interface
         {
@@ -686,6 +1079,13 @@ namespace Reflection
                 else
                     return reflection_interface_composite_summary_string(&obj);
             }
+            template <typename T> static void write_string(const T &obj, Writer &writer) // Same as `to_string()`, but appends to a writer.
+            {
+                if constexpr (is_primitive<T>() && !noexcept(reflection_interface_primitive_write_string((const T *)0, std::declval<Writer &>())))
+                    reflection_interface_primitive_write_string(&obj, writer);
+                else
+                    writer.put(to_string(obj));
+            }
             template <typename T> static constexpr bool has_to_string()
             {
                 if constexpr (is_primitive<T>())
@@ -700,6 +1100,7 @@ namespace Reflection
             template <typename T> static std::size_t primitive_byte_buffer_size(const T &obj) {return reflection_interface_primitive_byte_buffer_size(&obj);}
             template <typename T> static uint8_t *primitive_to_bytes(const T &obj, uint8_t *buf) {return reflection_interface_primitive_to_bytes(&obj, buf);} // Returns a next pointer.
             template <typename T> static const uint8_t *primitive_from_bytes(T &obj, const uint8_t *buf, const uint8_t *buf_end) {return reflection_interface_primitive_from_bytes(&obj, buf, buf_end);} // Returns a next pointer or 0 on failure.
+            template <typename T> static bool primitive_from_reader(T &obj, Bytes::Reader &reader) {return reflection_interface_primitive_from_reader(&obj, reader);} // Returns 0 on failure.
 
             template <typename T> static const auto &enum_string_value_map() {return reflection_interface_enum_string_value_map((const T *)0);}
             template <typename T> static const auto &enum_value_string_map() {return reflection_interface_enum_value_string_map((const T *)0);}
@@ -738,12 +1139,55 @@ namespace Reflection
             template <typename T> static container_iterator_t<T> container_insert_move(      T &obj, const container_const_iterator_t<T> &iter,       container_value_t<T> &&val) {return reflection_interface_container_insert_move(&obj, iter, (container_value_t<T> &&) val);}
             template <typename T> static container_iterator_t<T> container_erase      (      T &obj, const container_const_iterator_t<T> &begin, const container_const_iterator_t<T> &end) {return reflection_interface_container_erase(&obj, begin, end);}
 
+            // Returns 1 if the container elements can be copied in bulk, see `reflection_interface_container_data`.
+            template <typename T> static constexpr bool container_is_bulk()
+            {
+                if constexpr (!is_container<T>())
+                {
+                    return 0;
+                }
+                else
+                {
+                    using data_t = decltype(reflection_interface_container_data(std::declval<const T *>()));
+                    return std::is_same_v<data_t, const container_value_t<T> *>; // The fallback overload returns `void`.
+                }
+            }
+            template <typename T> static auto container_data  (const T &obj) {return reflection_interface_container_data(&obj);}
+            template <typename T> static auto container_data  (      T &obj) {return (container_value_t<T> *)reflection_interface_container_data(&obj);}
+            template <typename T> static void container_resize(      T &obj, std::size_t size) {reflection_interface_container_resize(&obj, size);}
+
 
             template <typename T, typename F> static void container_for_each(      T &obj, F &&func) {std::for_each(container_begin(obj), container_end(obj), (F &&) func);}
             template <typename T, typename F> static void container_for_each(const T &obj, F &&func) {std::for_each(container_cbegin(obj), container_cend(obj), (F &&) func);}
 
             template <typename T> static constexpr bool is_primitive() {return !is_structure<T>() && !is_container<T>();}
 
+          private:
+            template <typename T, std::size_t ...I> static constexpr std::size_t structure_fixed_byte_size(std::index_sequence<I...>)
+            {
+                std::size_t sizes[] = {fixed_byte_size<field_type<T, I>>()..., 0};
+                std::size_t ret = 0;
+                for (std::size_t i = 0; i < sizeof...(I); i++)
+                {
+                    if (sizes[i] == 0)
+                        return 0;
+                    ret += sizes[i];
+                }
+                return ret;
+            }
+          public:
+            // If all objects of type `T` need the same amount of bytes, returns it. Otherwise returns 0.
+            // Structures have fixed sizes if all their fields do. Containers never have them, since the size depends on the element count.
+            template <typename T> static constexpr std::size_t fixed_byte_size()
+            {
+                if constexpr (is_structure<T>())
+                    return structure_fixed_byte_size<T>(std::make_index_sequence<field_count<T>()>{});
+                else if constexpr (is_container<T>())
+                    return 0;
+                else
+                    return reflection_interface_primitive_fixed_byte_size((const T *)0);
+            }
+
 
             class Impl
             {
@@ -778,55 +1222,57 @@ namespace Reflection
 
     using InterfaceDetails::Interface;
 
-    template <typename T> std::string to_string(const T &object)
+    template <typename T> void write_string(const T &object, Writer &writer)
     {
         if constexpr (Interface::is_structure<T>())
         {
-            std::string ret = (Interface::structure_is_tuple<T>() ? "(" : "{");
+            writer.put(Interface::structure_is_tuple<T>() ? '(' : '{');
 
             auto lambda = [&](auto index)
             {
+                if constexpr (index.value != 0)
+                    writer.put(',');
                 constexpr bool no_names = !Interface::structure_is_tuple<T>();
                 if constexpr (no_names)
                 {
-                    ret += Interface::field_name<T, index.value>();
-                    ret += '=';
+                    writer.put(Interface::field_name<T, index.value>());
+                    writer.put('=');
                 }
-                ret += to_string(Interface::field<index.value>(object));
-                ret += ',';
+                write_string(Interface::field<index.value>(object), writer);
             };
 
             Cexpr::for_each(std::make_index_sequence<Interface::field_count<T>()>{}, lambda);
 
             if (Interface::field_count<T>())
-                ret[ret.size()-1] = (Interface::structure_is_tuple<T>() ? ')' : '}');
-
-            return ret;
+                writer.put(Interface::structure_is_tuple<T>() ? ')' : '}');
         }
         else if constexpr (Interface::is_container<T>())
         {
-            std::string ret = "[";
+            writer.put('[');
 
             for (auto it = Interface::container_cbegin(object); it != Interface::container_cend(object); it++)
             {
-                ret += to_string(*it);
-                ret += ',';
+                if (it != Interface::container_cbegin(object))
+                    writer.put(',');
+                write_string(*it, writer);
             }
 
-            if (Interface::container_size(object))
-                ret[ret.size()-1] = ']';
-            else
-                ret.push_back(']');
-
-            return ret;
+            writer.put(']');
         }
         else
         {
             static_assert(Interface::has_to_string<T>(), "This type doesn't support conversion to a string.");
-            return Interface::to_string(object);
+            Interface::write_string(object, writer);
         }
     }
 
+    template <typename T> std::string to_string(const T &object)
+    {
+        Writer writer;
+        write_string(object, writer);
+        return std::move(writer.str());
+    }
+
     template <typename T> std::string to_string_tree(const T &object, int depth = -1) // `depth == -1` means no limit.
     {
         [[maybe_unused]] auto Indent = [](std::string param, char symbol, bool no_leading_lf = 0) -> std::string
@@ -984,21 +1430,6 @@ namespace Reflection
                 return 0;
         }
 
-        template <typename T, std::size_t ...I> const auto &field_name_to_index_map(std::index_sequence<I...>)
-        {
-            static const std::unordered_map<std::string, std::size_t> map{{Interface::field_name<T,I>(), I}...};
-            return map;
-        }
-        template <typename T> std::size_t field_name_to_index(const std::string &name)
-        {
-            const auto &map = field_name_to_index_map<T>(std::make_index_sequence<Interface::field_count<T>()>{});
-            auto it = map.find(name);
-            if (it != map.end())
-                return it->second;
-            else
-                return std::size_t(-1);
-        }
-
         template <typename T, std::size_t ...I> const char *const (&field_index_to_name_array(std::index_sequence<I...>))[sizeof...(I)]
         {
             static constexpr const char *const array[]{Interface::field_name<T,I>()...};
@@ -1013,6 +1444,35 @@ namespace Reflection
                 return "";
         }
 
+        constexpr uint32_t field_name_hash(std::string_view name) // FNV-1a.
+        {
+            uint32_t ret = 2166136261u;
+            for (char ch : name)
+            {
+                ret ^= (unsigned char)ch;
+                ret *= 16777619u;
+            }
+            return ret;
+        }
+        template <typename T, std::size_t ...I> constexpr auto field_name_hash_array(std::index_sequence<I...>)
+        {
+            struct Array {uint32_t hashes[sizeof...(I) > 0 ? sizeof...(I) : 1];};
+            return Array{{field_name_hash(Interface::field_name<T,I>())...}};
+        }
+        template <typename T> std::size_t field_name_to_index(std::string_view name) // Returns -1 if there is no such field.
+        {
+            // The hashes are computed at compile time. Structures have few fields, so a linear search is fine.
+            constexpr std::size_t count = Interface::field_count<T>();
+            static constexpr auto hashes = field_name_hash_array<T>(std::make_index_sequence<count>{});
+            uint32_t hash = field_name_hash(name);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                if (hashes.hashes[i] == hash && name == field_index_to_name<T>(i))
+                    return i;
+            }
+            return std::size_t(-1);
+        }
+
         // `stack` records field names. For container elements, it will have a null followed by (index + 1).
         template <typename T> const char *from_string(T &object, const char *str, bool verbose_errors, Error &error, std::string &error_details, std::vector<const char *> &stack)
         {
@@ -1113,17 +1573,17 @@ namespace Reflection
                             break;
                         }
 
-                        std::string field_name;
-
+                        const char *field_name_begin = str;
                         while (Strings::is_alphanum(*str))
-                            field_name += *str++;
+                            str++;
+                        std::string_view field_name(field_name_begin, str - field_name_begin);
 
                         std::size_t field_index = field_name_to_index<T>(field_name);
                         if (field_index == std::size_t(-1))
                         {
                             error = Error::invalid_field_name;
                             if (verbose_errors)
-                                error_details = (field_name.empty() ? " " : field_name);
+                                error_details = (field_name.empty() ? " " : std::string(field_name));
                             return 0;
                         }
 
@@ -1131,7 +1591,7 @@ namespace Reflection
                         {
                             error = Error::duplicate_fields;
                             if (verbose_errors)
-                                error_details = (field_name.empty() ? " " : field_name);
+                                error_details = (field_name.empty() ? " " : std::string(field_name));
                             return 0;
                         }
 
@@ -1297,7 +1757,11 @@ namespace Reflection
 
     template <typename T> std::size_t byte_buffer_size(const T &object)
     {
-        if constexpr (Interface::is_structure<T>())
+        if constexpr (Interface::fixed_byte_size<T>() != 0)
+        {
+            return Interface::fixed_byte_size<T>();
+        }
+        else if constexpr (Interface::is_structure<T>())
         {
             std::size_t size = 0;
 
@@ -1310,6 +1774,10 @@ namespace Reflection
 
             return size;
         }
+        else if constexpr (Interface::is_container<T>() && Interface::fixed_byte_size<Interface::container_value_t<T>>() != 0)
+        {
+            return sizeof(uint32_t) + Interface::container_size(object) * Interface::fixed_byte_size<Interface::container_value_t<T>>(); // No need to visit the elements.
+        }
         else if constexpr (Interface::is_container<T>())
         {
             std::size_t size = sizeof(uint32_t);
@@ -1341,6 +1809,15 @@ namespace Reflection
 
             return buf;
         }
+        else if constexpr (Interface::container_is_bulk<T>())
+        {
+            using value_t = Interface::container_value_t<T>;
+            std::size_t size = Interface::container_size(object);
+            buf = to_bytes(uint32_t(size), buf);
+            if (size > 0) // `data()` can be null for empty containers, and `memcpy` doesn't like that.
+                Bytes::copy_fixing_order<value_t>(buf, Interface::container_data(object), size);
+            return buf + size * sizeof(value_t);
+        }
         else if constexpr (Interface::is_container<T>())
         {
             buf = to_bytes(uint32_t(Interface::container_size(object)), buf);
@@ -1377,6 +1854,19 @@ namespace Reflection
 
             return buf;
         }
+        else if constexpr (Interface::container_is_bulk<T>())
+        {
+            using value_t = Interface::container_value_t<T>;
+            uint32_t size;
+            buf = from_bytes(size, buf, buf_end);
+            if (!buf || std::size_t(buf_end - buf) / sizeof(value_t) < size)
+                return 0;
+
+            Interface::container_resize(object, size);
+            if (size > 0) // `data()` can be null for empty containers, and `memcpy` doesn't like that.
+                Bytes::copy_fixing_order<value_t>(Interface::container_data(object), buf, size);
+            return buf + size * sizeof(value_t);
+        }
         else if constexpr (Interface::is_container<T>())
         {
             uint32_t size;
@@ -1402,6 +1892,66 @@ namespace Reflection
             return Interface::primitive_from_bytes(object, buf, buf_end);
         }
     }
+
+    // Same as above, but reads from a stream. Returns 0 on failure.
+    // WARNING: `object` may end up in an invalid state in case of a failure.
+    template <typename T> bool from_bytes(T &object, Bytes::Reader &reader)
+    {
+        if constexpr (Interface::is_structure<T>())
+        {
+            auto lambda = [&](auto index) -> bool
+            {
+                return from_bytes(Interface::field<index.value>(object), reader);
+            };
+
+            return Cexpr::for_each_while(std::make_index_sequence<Interface::field_count<T>()>{}, lambda);
+        }
+        else if constexpr (Interface::container_is_bulk<T>())
+        {
+            using value_t = Interface::container_value_t<T>;
+            uint32_t size;
+            if (!from_bytes(size, reader))
+                return 0;
+
+            // Growing in pieces, to avoid allocating a lot of memory if the size is broken.
+            constexpr std::size_t piece = 0x10000;
+            Interface::container_resize(object, 0);
+            std::size_t done = 0;
+            while (done < size)
+            {
+                std::size_t segment = std::min(std::size_t(size) - done, piece);
+                Interface::container_resize(object, done + segment);
+                if (!reader.read(Interface::container_data(object) + done, segment * sizeof(value_t)))
+                    return 0;
+                done += segment;
+            }
+            if (size > 0)
+                Bytes::fix_order_array<value_t>(Interface::container_data(object), size);
+            return 1;
+        }
+        else if constexpr (Interface::is_container<T>())
+        {
+            uint32_t size;
+            if (!from_bytes(size, reader))
+                return 0;
+
+            Interface::container_erase(object, Interface::container_cbegin(object), Interface::container_cend(object));
+
+            for (uint32_t i = 0; i < size; i++)
+            {
+                Interface::container_mutable_value_t<T> tmp;
+                if (!from_bytes(tmp, reader))
+                    return 0;
+                Interface::container_insert_move(object, Interface::container_cend(object), std::move(tmp));
+            }
+
+            return 1;
+        }
+        else // primitive
+        {
+            return Interface::primitive_from_reader(object, reader);
+        }
+    }
 }
 
 /* Struct/class reflection.
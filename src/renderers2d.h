@@ -21,6 +21,8 @@ namespace Renderers
             (fvec4)(color),
             (fvec2)(texture_pos),
             (fvec3)(factors),
+            (fvec3)(sdf), // x - 1 if the texture alpha is a signed distance field, y - outline width, z - outline softness. Both are in distance field units, where 0.5 is the spread.
+            (fvec4)(sdf_outline), // Outline color and alpha.
         ))
 
         ReflectStruct(Uniforms, (
@@ -72,6 +74,10 @@ namespace Renderers
 
             bool m_flip_x = 0, m_flip_y = 0;
 
+            bool m_sdf = 0;
+            fvec4 m_sdf_outline = fvec4(0);
+            float m_sdf_outline_width = 0, m_sdf_outline_softness = 0;
+
           public:
             Quad_t(decltype(Poly2D::queue) *queue, fvec2 pos, fvec2 size) : queue(queue), m_pos(pos), m_size(size) {}
 
@@ -91,6 +97,7 @@ namespace Renderers
                 DebugAssert("2D poly renderer: Quad with absolute texture coordinates mode but no texture coordinates specified.", m_abs_tex_pos <= has_texture);
                 DebugAssert("2D poly renderer: Quad with texture and color, but without a mixing factor.", (has_texture && has_color) == has_tex_color_fac);
                 DebugAssert("2D poly renderer: Quad with a matrix but without a center specified.", has_matrix <= has_center);
+                DebugAssert("2D poly renderer: Quad with a distance field mode but without a texture.", m_sdf <= has_texture);
 
                 if (m_abs_pos)
                     m_size -= m_pos;
@@ -126,7 +133,11 @@ namespace Renderers
                 }
 
                 for (int i = 0; i < 4; i++)
+                {
                     out[i].factors.z = m_beta[i];
+                    out[i].sdf = fvec3(m_sdf, m_sdf_outline_width, m_sdf_outline_softness);
+                    out[i].sdf_outline = m_sdf_outline;
+                }
 
                 if (m_flip_x)
                 {
@@ -328,6 +339,14 @@ namespace Renderers
                 m_flip_y = f;
                 return (ref)*this;
             }
+            ref sdf(fvec3 outline_color = fvec3(0), float outline_alpha = 0, float outline_width = 0, float outline_softness = 0) // Treat texture alpha as a signed distance field with the edge at 0.5. Outline width and softness are measured in distance field units (0.5 is the spread). Non-zero softness turns the outline into a glow.
+            {
+                m_sdf = 1;
+                m_sdf_outline = outline_color.to_vec4(outline_alpha);
+                m_sdf_outline_width = outline_width;
+                m_sdf_outline_softness = outline_softness;
+                return (ref)*this;
+            }
         };
         class Triangle_t
         {
@@ -393,6 +412,8 @@ namespace Renderers
                 {
                     out[i].factors.z = m_beta[i];
                     out[i].texture_pos = m_tex_pos[i];
+                    out[i].sdf = fvec3(0);
+                    out[i].sdf_outline = fvec4(0);
                 }
 
                 if (has_matrix)
@@ -573,6 +594,8 @@ namespace Renderers
                 int spacing = 0, line_gap = 0;
                 int tab_width = 4; // Measured in spaces
                 bool kerning = 1;
+                fvec3 outline_color = {0,0,0}; // Outline settings only affect distance field fonts.
+                float outline_alpha = 0, outline_width = 0, outline_softness = 0; // Width and softness are measured in atlas pixels.
                 std::vector<callback_type> callbacks;
             };
 
@@ -607,6 +630,9 @@ namespace Renderers
                 std::vector<Line> lines;
                 std::size_t line_number = 0;
 
+                std::vector<uint16_t> chars; // Decoded once for both passes.
+                u8decode16(obj_state.str, chars);
+
                 auto Loop = [&](bool do_render)
                 {
                     int line_ascent  = obj_state.ch_map->Ascent(),
@@ -681,60 +707,60 @@ namespace Renderers
                     };
 
                     StartLine();
-                    auto it = obj_state.str.begin();
-                    while (it != obj_state.str.end())
+                    for (uint16_t ch : chars)
                     {
-                        if (u8isfirstbyte(it))
+                        switch (ch)
                         {
-                            switch (*it)
+                          default:
                             {
-                              default:
-                                {
-                                    uint16_t ch = u8decode(it);
-
-                                    Graphics::CharMap::Char info = obj_state.ch_map->Get(ch);
+                                Graphics::CharMap::Char info = obj_state.ch_map->Get(ch);
 
-                                    if (obj_state.kerning)
-                                        pos.x += obj_state.ch_map->Kerning(prev_ch, ch);
+                                if (obj_state.kerning)
+                                    pos.x += obj_state.ch_map->Kerning(prev_ch, ch);
 
-                                    std::vector<RenderData> render{{obj_state.color, obj_state.alpha, obj_state.beta, obj_state.matrix /mul/ fmat3::translate2D(pos + info.offset)}};
+                                std::vector<RenderData> render{{obj_state.color, obj_state.alpha, obj_state.beta, obj_state.matrix /mul/ fmat3::translate2D(pos + info.offset)}};
 
-                                    CallCallbacks(ch, info, render);
+                                CallCallbacks(ch, info, render);
 
-                                    if (do_render)
+                                if (do_render)
+                                {
+                                    int sdf_spread = obj_state.ch_map->SdfSpread();
+                                    for (const auto &it : render)
                                     {
-                                        for (const auto &it : render)
+                                        Quad_t quad(saved_queue, obj_state.pos, info.size);
+                                        quad.tex(info.tex_pos)
+                                            .alpha(it.alpha).beta(it.beta).color(it.color).mix(0)
+                                            .center(ivec2(0)).matrix(it.matrix);
+                                        if (sdf_spread)
                                         {
-                                            Quad_t(saved_queue, obj_state.pos, info.size)
-                                                .tex(info.tex_pos)
-                                                .alpha(it.alpha).beta(it.beta).color(it.color).mix(0)
-                                                .center(ivec2(0)).matrix(it.matrix);
+                                            float units_per_pixel = 0.5 / sdf_spread;
+                                            quad.sdf(obj_state.outline_color, obj_state.outline_alpha,
+                                                     obj_state.outline_width * units_per_pixel, obj_state.outline_softness * units_per_pixel);
                                         }
                                     }
+                                }
 
-                                    pos.x += info.advance + (last_spacing = obj_state.spacing);
+                                pos.x += info.advance + (last_spacing = obj_state.spacing);
 
-                                    prev_ch = ch;
-                                }
-                                break;
-                              case '\n':
-                                {
-                                    EndLine();
-                                    prev_ch = 0xffff;
-                                    StartLine();
-                                }
-                                break;
-                              case '\t':
-                                {
-                                    int tab_pixels = obj_state.tab_width * obj_state.ch_map->Get(' ').advance;
-                                    pos.x = (pos.x - line_offset_x + tab_pixels - 1) / tab_pixels * tab_pixels;
-                                    prev_ch = '\t';
-                                }
-                                break;
+                                prev_ch = ch;
+                            }
+                            break;
+                          case '\n':
+                            {
+                                EndLine();
+                                prev_ch = 0xffff;
+                                StartLine();
                             }
-                            index++;
+                            break;
+                          case '\t':
+                            {
+                                int tab_pixels = obj_state.tab_width * obj_state.ch_map->Get(' ').advance;
+                                pos.x = (pos.x - line_offset_x + tab_pixels - 1) / tab_pixels * tab_pixels;
+                                prev_ch = '\t';
+                            }
+                            break;
                         }
-                        it++;
+                        index++;
                     }
 
                     std::vector<RenderData> tmp_render{{obj_state.color, obj_state.alpha, obj_state.beta, fmat3::identity()}};
@@ -882,6 +908,14 @@ namespace Renderers
                 obj_state.kerning = k;
                 return (ref)*this;
             }
+            ref outline(fvec3 color, float alpha, float width, float softness = 0) // Only affects distance field fonts. Width and softness are measured in atlas pixels and are limited by the spread. Non-zero softness gives a glow.
+            {
+                obj_state.outline_color = color;
+                obj_state.outline_alpha = alpha;
+                obj_state.outline_width = width;
+                obj_state.outline_softness = softness;
+                return (ref)*this;
+            }
 
             template <typename F> ref preset(F &&func) // void func(Text_t &ref)
             {
@@ -905,22 +939,42 @@ namespace Renderers
 VARYING( vec4 , color       )
 VARYING( vec2 , texture_pos )
 VARYING( vec3 , factors     )
+VARYING( vec3 , sdf         )
+VARYING( vec4 , sdf_outline )
 void main()
 {
     gl_Position = u_matrix * vec4(a_pos, 0, 1);
     v_color       = a_color;
     v_texture_pos = a_texture_pos / u_texture_size;
     v_factors     = a_factors;
+    v_sdf         = a_sdf;
+    v_sdf_outline = a_sdf_outline;
 })";
             constexpr const char *f = R"(
 VARYING( vec4 , color       )
 VARYING( vec2 , texture_pos )
 VARYING( vec3 , factors     )
+VARYING( vec3 , sdf         )
+VARYING( vec4 , sdf_outline )
 void main()
 {
     vec4 tex_color = texture2D(u_texture, v_texture_pos);
+    float edge_width = max(fwidth(tex_color.a) * 0.7, 0.0001);
+    float outline = 0.;
+    if (v_sdf.x > 0.5)
+    {
+        float fill = smoothstep(0.5 - edge_width, 0.5 + edge_width, tex_color.a);
+        outline = smoothstep(0.5 - v_sdf.y - v_sdf.z - edge_width, 0.5 - v_sdf.y + edge_width, tex_color.a) * (1. - fill) * v_sdf_outline.a * v_factors.y;
+        tex_color.a = fill;
+    }
     gl_FragColor = vec4(v_color.rgb * (1. - v_factors.x) + tex_color.rgb * v_factors.x,
                         v_color.a   * (1. - v_factors.y) + tex_color.a   * v_factors.y);
+    if (outline > 0.)
+    {
+        float alpha = gl_FragColor.a + outline;
+        gl_FragColor.rgb = (gl_FragColor.rgb * gl_FragColor.a + v_sdf_outline.rgb * outline) / alpha;
+        gl_FragColor.a = alpha;
+    }
     vec4 result = u_color_matrix * vec4(gl_FragColor.rgb, 1);
     gl_FragColor.a *= result.a;
     gl_FragColor.rgb = result.rgb * gl_FragColor.a;
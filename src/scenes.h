@@ -2,12 +2,14 @@
 #define SCENES_H_INCLUDED
 
 #include <algorithm>
-#include <any>
+#include <atomic>
+#include <cstddef>
 #include <functional>
-#include <typeindex>
+#include <memory>
+#include <type_traits>
 #include <typeinfo>
-#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "program.h"
 #include "strings.h"
@@ -15,34 +17,191 @@
 class Scene
 {
     using func_t = std::function<void(const Scene &)>;
+    using render_func_t = std::function<void(const Scene &scene, const Scene &simulation, float time)>; // `time` is how far we are between the last two ticks, from 0 to 1.
 
-    mutable std::unordered_map<std::type_index, std::any> map;
-    func_t func_tick, func_render;
+    struct PoolBase
+    {
+        virtual ~PoolBase() {}
+        virtual std::unique_ptr<PoolBase> Copy() const = 0;
+        virtual void AssignFrom(const PoolBase &other) = 0; // `other` must have the same type. Reuses the existing storage when possible.
+        virtual void *Data() = 0;
+    };
+    template <typename T> struct Pool : PoolBase
+    {
+        std::vector<T> objects;
+
+        std::unique_ptr<PoolBase> Copy() const override
+        {
+            return std::make_unique<Pool>(*this);
+        }
+        void AssignFrom(const PoolBase &other) override
+        {
+            const auto &other_objects = static_cast<const Pool &>(other).objects;
+            if constexpr (std::is_copy_assignable_v<T>)
+            {
+                objects = other_objects;
+            }
+            else
+            {
+                objects.clear(); // This keeps the capacity.
+                for (const T &object : other_objects)
+                    objects.push_back(object);
+            }
+        }
+        void *Data() override
+        {
+            return objects.data();
+        }
+    };
+
+    // Each type gets a small unique index when it's first used. Both vectors below are indexed by it.
+    static std::size_t NextSlot()
+    {
+        static std::atomic<std::size_t> counter{0};
+        return counter++;
+    }
+    template <typename T> static std::size_t Slot()
+    {
+        static const std::size_t ret = NextSlot();
+        return ret;
+    }
+
+    std::vector<std::unique_ptr<PoolBase>> pools; // Null for types that the scene doesn't have.
+    std::vector<void *> first_objects; // `pools[i]->Data()`, or null. This makes lookups cheap.
+    func_t func_tick;
+    render_func_t func_render;
+
+    std::unique_ptr<Scene> simulation; // Null until `Simulation()` is first called.
+    bool threaded_simulation = 0;
+
+    template <typename T> Pool<T> &GetPool()
+    {
+        std::size_t slot = Slot<T>();
+        if (slot >= pools.size())
+        {
+            pools.resize(slot + 1);
+            first_objects.resize(slot + 1);
+        }
+        if (!pools[slot])
+            pools[slot] = std::make_unique<Pool<T>>();
+        return static_cast<Pool<T> &>(*pools[slot]);
+    }
 
   public:
+    template <typename T> class Range
+    {
+        T *first = 0, *last = 0;
+      public:
+        Range() {}
+        Range(T *first, T *last) : first(first), last(last) {}
+        [[nodiscard]] T *begin() const {return first;}
+        [[nodiscard]] T *end() const {return last;}
+        [[nodiscard]] std::size_t size() const {return last - first;}
+        [[nodiscard]] bool empty() const {return first == last;}
+    };
+
     Scene() {}
 
-    template <typename ...T, typename ...P> void Add(P &&... params)
+    Scene(const Scene &other) : func_tick(other.func_tick), func_render(other.func_render), threaded_simulation(other.threaded_simulation)
+    {
+        if (other.simulation)
+            simulation = std::make_unique<Scene>(*other.simulation);
+        pools.resize(other.pools.size());
+        first_objects.resize(other.pools.size());
+        for (std::size_t i = 0; i < pools.size(); i++)
+        {
+            if (!other.pools[i])
+                continue;
+            pools[i] = other.pools[i]->Copy();
+            first_objects[i] = pools[i]->Data();
+        }
+    }
+    Scene(Scene &&) = default;
+    Scene &operator=(const Scene &other) // Unlike the copy constructor, reuses the existing pools, so copying into the same scene over and over doesn't allocate once the sizes settle.
+    {
+        if (&other == this)
+            return *this;
+
+        func_tick = other.func_tick;
+        func_render = other.func_render;
+        threaded_simulation = other.threaded_simulation;
+
+        if (!other.simulation)
+            simulation = nullptr;
+        else if (simulation)
+            *simulation = *other.simulation;
+        else
+            simulation = std::make_unique<Scene>(*other.simulation);
+
+        pools.resize(other.pools.size());
+        first_objects.resize(other.pools.size());
+        for (std::size_t i = 0; i < pools.size(); i++)
+        {
+            if (!other.pools[i])
+                pools[i] = nullptr;
+            else if (pools[i])
+                pools[i]->AssignFrom(*other.pools[i]);
+            else
+                pools[i] = other.pools[i]->Copy();
+            first_objects[i] = pools[i] ? pools[i]->Data() : nullptr;
+        }
+        return *this;
+    }
+    Scene &operator=(Scene &&) = default;
+
+    template <typename ...T, typename ...P> void Add(P &&... params) // Adds one object of each type. It's an error if the scene already has objects of any of those types.
     {
-        if (!(map.insert({typeid(T), std::make_any<T>(std::forward<P>(params)...)}).second && ...))
+        if (((GetPool<T>().objects.size() > 0) || ...))
             Program::Error("Duplicate member objects specified for a scene.");
+        if constexpr (sizeof...(T) == 1)
+            (Append<T>(std::forward<P>(params)...), ...);
+        else
+            (Append<T>(params...), ...); // Can't forward the same parameters more than once.
+    }
+    template <typename T, typename ...P> T &Append(P &&... params) // Adds one more object of type `T`. References to other objects of the same type are invalidated.
+    {
+        Pool<T> &pool = GetPool<T>();
+        T &ret = pool.objects.emplace_back(std::forward<P>(params)...);
+        first_objects[Slot<T>()] = pool.objects.data();
+        return ret;
     }
     void SetTick(func_t func)
     {
         func_tick = std::move(func);
     }
-    void SetRender(func_t func)
+    void SetRender(render_func_t func)
     {
         func_render = std::move(func);
     }
 
-    template <typename T> T *GetOpt() const
+    /* Objects that only interact with each other, and don't touch the input, the editor or the graphics in their `Tick()`.
+     * They live in a separate scene with its own tick function, so they can be ticked on a `Timing::SimulationThread`.
+     * The render function gets them as a separate parameter, since when threaded, they come from a snapshot instead.
+     */
+    Scene &Simulation()
     {
-        auto it = map.find(typeid(T));
-        if (it != map.end())
-            return std::any_cast<T>(&it->second);
-        else
-            return 0;
+        if (!simulation)
+            simulation = std::make_unique<Scene>();
+        return *simulation;
+    }
+    const Scene &Simulation() const
+    {
+        static const Scene empty;
+        return simulation ? *simulation : empty;
+    }
+    void SetThreadedSimulation(bool t) // If set, `Tick()` doesn't tick the simulation, and the main loop runs it on a separate thread instead.
+    {
+        threaded_simulation = t;
+    }
+    [[nodiscard]] bool ThreadedSimulation() const
+    {
+        return threaded_simulation;
+    }
+
+    template <typename T> T *GetOpt() const // If there are several objects of this type, returns the first one.
+    {
+        std::size_t slot = Slot<T>();
+        return slot < first_objects.size() ? (T *)first_objects[slot] : 0;
     }
     template <typename T> T &Get() const
     {
@@ -51,16 +210,30 @@ class Scene
             Program::Error(Str("Scene has no object with type `", typeid(T).name(), "`."));
         return *ptr;
     }
+    template <typename T> Range<T> All() const // All objects of type `T`, stored contiguously.
+    {
+        std::size_t slot = Slot<T>();
+        if (slot >= pools.size() || !pools[slot])
+            return {};
+        auto &objects = static_cast<Pool<T> &>(*pools[slot]).objects;
+        return {objects.data(), objects.data() + objects.size()};
+    }
 
     void Tick()
     {
-        func_tick(*this);
+        if (func_tick)
+            func_tick(*this);
+        if (simulation && !threaded_simulation)
+            simulation->Tick();
     }
-    void Render()
+    void Render(float time)
     {
-        func_render(*this);
+        Render(Simulation(), time);
+    }
+    void Render(const Scene &simulation_snapshot, float time)
+    {
+        func_render(*this, simulation_snapshot, time);
     }
 };
 
-
 #endif
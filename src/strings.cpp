@@ -1,5 +1,9 @@
 #include "strings.h"
 
+#include <cstring>
+
+#include "program.h"
+
 namespace Strings
 {
     inline namespace Encodings
@@ -40,5 +44,149 @@ namespace Strings
                                                  0x0448, 0x0449, 0x044A, 0x044B, 0x044C, 0x044D, 0x044E, 0x044F};
             return array;
         }
+
+        Codepage::Codepage(const uint16_t (&table)[256]) : table(&table), page_index{}, pages(256) // Page 0 maps nothing.
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                uint16_t ch = table[i];
+                if (ch == u8invalidchar)
+                    ch = 0xfffd;
+
+                char *seq = utf8[i];
+                if (ch < 0x80)
+                {
+                    seq[0] = ch;
+                    seq[3] = 1;
+                }
+                else if (ch < 0x800)
+                {
+                    seq[0] = 0b1100'0000 | (ch >> 6);
+                    seq[1] = 0b1000'0000 | (ch & 0b0011'1111);
+                    seq[3] = 2;
+                }
+                else
+                {
+                    seq[0] = 0b1110'0000 | (ch >> 12);
+                    seq[1] = 0b1000'0000 | ((ch >> 6) & 0b0011'1111);
+                    seq[2] = 0b1000'0000 | (ch & 0b0011'1111);
+                    seq[3] = 3;
+                }
+
+                if (table[i] == u8invalidchar)
+                    continue;
+                uint8_t &page = page_index[table[i] >> 8];
+                if (page == 0)
+                {
+                    DebugAssert("Codepage: Too many distinct 256-character blocks.", pages.size() < 256 * 256);
+                    page = pages.size() / 256;
+                    pages.resize(pages.size() + 256);
+                }
+                pages[page * 256 + (table[i] & 0xff)] = i;
+            }
+        }
+
+        void Codepage::ToUTF8(std::string_view str, std::string &out) const
+        {
+            std::size_t old_size = out.size();
+            out.resize(old_size + str.size() * 3 + 1); // +1 for the last `memcpy()`.
+            char *dst = out.data() + old_size;
+
+            const char *it = str.data(), *end = it + str.size();
+            while (it != end)
+            {
+                #ifdef __SSE2__
+                while ((*it & 0b1000'0000) == 0 && end - it >= 16)
+                {
+                    __m128i block = _mm_loadu_si128((const __m128i *)it);
+                    if (_mm_movemask_epi8(block))
+                        break;
+                    _mm_storeu_si128((__m128i *)dst, block);
+                    it += 16;
+                    dst += 16;
+                }
+                if (it == end)
+                    break;
+                #endif
+
+                const char *seq = utf8[(unsigned char)*it++];
+                std::memcpy(dst, seq, 4); // Copying all 4 bytes at once is faster than looking at the length first. There is always enough space.
+                dst += seq[3];
+            }
+
+            out.resize(dst - out.data());
+        }
+
+        bool Codepage::FromUTF8(std::string_view str, std::string &out, char replacement) const
+        {
+            bool ok = 1;
+
+            std::size_t old_size = out.size();
+            out.resize(old_size + str.size());
+            char *dst = out.data() + old_size;
+
+            const char *it = str.data(), *end = it + str.size();
+            while (it != end)
+            {
+                #ifdef __SSE2__
+                while ((*it & 0b1000'0000) == 0 && end - it >= 16)
+                {
+                    __m128i block = _mm_loadu_si128((const __m128i *)it);
+                    if (_mm_movemask_epi8(block))
+                        break;
+                    _mm_storeu_si128((__m128i *)dst, block);
+                    it += 16;
+                    dst += 16;
+                }
+                if (it == end)
+                    break;
+                #endif
+
+                if ((*it & 0b1000'0000) == 0)
+                {
+                    *dst++ = *it++;
+                    continue;
+                }
+
+                std::size_t len = u8charlen(*it);
+                if (len == 2 && end - it >= 2 && !u8isfirstbyte(it[1]))
+                {
+                    if (!Encode(((*it & 0b0001'1111) << 6) | (it[1] & 0b0011'1111), *dst))
+                    {
+                        *dst = replacement;
+                        ok = 0;
+                    }
+                    it += 2;
+                }
+                else if (len == 3 && end - it >= 3 && !u8isfirstbyte(it[1]) && !u8isfirstbyte(it[2]))
+                {
+                    if (!Encode(((*it & 0b0000'1111) << 12) | ((it[1] & 0b0011'1111) << 6) | (it[2] & 0b0011'1111), *dst))
+                    {
+                        *dst = replacement;
+                        ok = 0;
+                    }
+                    it += 3;
+                }
+                else
+                {
+                    // An invalid sequence is replaced up to the next first byte.
+                    *dst = replacement;
+                    ok = 0;
+                    do
+                        it++;
+                    while (it != end && !u8isfirstbyte(*it));
+                }
+                dst++;
+            }
+
+            out.resize(dst - out.data());
+            return ok;
+        }
+
+        const Codepage &cp1251_codepage()
+        {
+            static const Codepage ret(cp1251());
+            return ret;
+        }
     }
 }
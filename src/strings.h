@@ -2,37 +2,176 @@
 #define STRINGS_H_INCLUDED
 
 #include <algorithm>
+#include <cctype>
+#include <charconv>
 #include <cstddef>
 #include <iomanip>
 #include <string>
 #include <string_view>
 #include <sstream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
 
 namespace Strings
 {
     namespace impl
     {
-        inline std::stringstream ss;
+        // Holds the formatting state (flags, width, precision, fill) used by `Str()`. Types that aren't handled directly are printed through it.
+        // Thread-local, so that `Str()` can be used from worker threads.
+        inline thread_local std::stringstream ss;
         inline const std::stringstream::fmtflags stdfmt = ss.flags();
+
+        inline void AppendText(std::ostream &stream, std::string &buffer, std::string_view text) // Pads the text according to `stream.width()`, then resets the width like streams do.
+        {
+            std::size_t width = std::max(std::streamsize(0), stream.width());
+            if (width > text.size())
+            {
+                std::size_t padding = width - text.size();
+                if ((stream.flags() & std::ios_base::adjustfield) == std::ios_base::left)
+                {
+                    buffer += text;
+                    buffer.append(padding, stream.fill());
+                }
+                else
+                {
+                    buffer.append(padding, stream.fill());
+                    buffer += text;
+                }
+            }
+            else
+            {
+                buffer += text;
+            }
+            stream.width(0);
+        }
+
+        template <typename T> void AppendFallback(std::stringstream &stream, std::string &buffer, T &&param) // The stream is kept empty between calls.
+        {
+            stream << std::forward<T>(param);
+            stream.clear();
+            if (stream.tellp() > 0) // Manipulators such as `std::setw()` don't print anything, so they are cheap.
+            {
+                buffer += stream.str();
+                stream.str("");
+            }
+        }
+
+        // The stream is passed as a parameter, because accessing a thread-local variable with a constructor has a noticeable cost.
+        template <typename T> void Append(std::stringstream &stream, std::string &buffer, T &&param)
+        {
+            using type = std::remove_cv_t<std::remove_reference_t<T>>;
+            std::ios_base::fmtflags flags = stream.flags();
+
+            if constexpr (std::is_invocable_v<T, std::ios_base &>) // Manipulators without parameters, such as `std::hex`.
+            {
+                param(stream);
+            }
+            else if constexpr (std::is_same_v<type, decltype(std::setw(0))>
+                            || std::is_same_v<type, decltype(std::setprecision(0))>
+                            || std::is_same_v<type, decltype(std::setfill(' '))>
+                            || std::is_same_v<type, decltype(std::setbase(0))>
+                            || std::is_same_v<type, decltype(std::setiosflags({}))>
+                            || std::is_same_v<type, decltype(std::resetiosflags({}))>) // Standard manipulators with parameters. They don't print anything.
+            {
+                stream << param;
+            }
+            else if constexpr (std::is_same_v<type, bool>)
+            {
+                if (flags & std::ios_base::boolalpha)
+                    AppendText(stream, buffer, param ? "true" : "false");
+                else
+                    AppendText(stream, buffer, param ? "1" : "0");
+            }
+            else if constexpr (std::is_same_v<type, char> || std::is_same_v<type, signed char> || std::is_same_v<type, unsigned char>) // Streams print those as characters.
+            {
+                char ch = param;
+                AppendText(stream, buffer, std::string_view(&ch, 1));
+            }
+            else if constexpr (std::is_integral_v<type>)
+            {
+                if (flags & (std::ios_base::showbase | std::ios_base::showpos) || (flags & std::ios_base::adjustfield) == std::ios_base::internal)
+                {
+                    AppendFallback(stream, buffer, std::forward<T>(param));
+                    return;
+                }
+
+                std::ios_base::fmtflags basefield = flags & std::ios_base::basefield;
+                int base = basefield == std::ios_base::hex ? 16 : basefield == std::ios_base::oct ? 8 : 10;
+
+                char tmp[72];
+                std::to_chars_result result;
+                if (base != 10)
+                    result = std::to_chars(tmp, tmp + sizeof tmp, std::make_unsigned_t<type>(param), base); // Streams print negative numbers as unsigned in those bases.
+                else
+                    result = std::to_chars(tmp, tmp + sizeof tmp, param);
+                if (base == 16 && (flags & std::ios_base::uppercase))
+                    std::transform(tmp, result.ptr, tmp, [](char ch){return std::toupper((unsigned char)ch);});
+                AppendText(stream, buffer, std::string_view(tmp, result.ptr - tmp));
+            }
+            #if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611
+            else if constexpr (std::is_floating_point_v<type>)
+            {
+                std::ios_base::fmtflags floatfield = flags & std::ios_base::floatfield;
+                if (flags & (std::ios_base::showpos | std::ios_base::showpoint | std::ios_base::uppercase) || floatfield == (std::ios_base::fixed | std::ios_base::scientific) || (flags & std::ios_base::adjustfield) == std::ios_base::internal)
+                {
+                    AppendFallback(stream, buffer, std::forward<T>(param));
+                    return;
+                }
+
+                std::chars_format format = floatfield == std::ios_base::fixed ? std::chars_format::fixed : floatfield == std::ios_base::scientific ? std::chars_format::scientific : std::chars_format::general;
+                char tmp[128];
+                auto result = std::to_chars(tmp, tmp + sizeof tmp, param, format, int(stream.precision()));
+                if (result.ec != std::errc{}) // Huge numbers in the fixed format may not fit.
+                {
+                    AppendFallback(stream, buffer, std::forward<T>(param));
+                    return;
+                }
+                AppendText(stream, buffer, std::string_view(tmp, result.ptr - tmp));
+            }
+            #endif
+            else if constexpr (std::is_convertible_v<const T &, std::string_view>)
+            {
+                AppendText(stream, buffer, std::string_view(param));
+            }
+            else
+            {
+                AppendFallback(stream, buffer, std::forward<T>(param));
+            }
+        }
     }
 
-    // Str() resets stringstream flags first.
-    // Str_() does not.
+    /* Formats the parameters like `std::ostream::operator<<` does. Standard manipulators can be used.
+     * Numbers, characters and strings are formatted directly, without going through a stream, everything else uses a thread-local stringstream.
+     * The formatting state persists between calls, like it would for a stream.
+     * Str() resets formatting flags first.
+     * Str_() does not.
+     */
 
     template <typename ...P> [[nodiscard]] std::string Str(P &&... params)
     {
-        impl::ss.clear();
-        impl::ss.str("");
-        impl::ss.flags(impl::stdfmt);
-        (impl::ss << ... << params);
-        return impl::ss.str();
+        std::stringstream &stream = impl::ss;
+        stream.flags(impl::stdfmt);
+        std::string ret;
+        (impl::Append(stream, ret, std::forward<P>(params)) , ...);
+        return ret;
     }
     template <typename ...P> [[nodiscard]] std::string Str_(P &&... params)
     {
-        impl::ss.clear();
-        impl::ss.str("");
-        (impl::ss << ... << params);
-        return impl::ss.str();
+        std::stringstream &stream = impl::ss;
+        std::string ret;
+        (impl::Append(stream, ret, std::forward<P>(params)) , ...);
+        return ret;
+    }
+    template <typename ...P> void StrAppend(std::string &buffer, P &&... params) // Same as `buffer += Str(params...)`, but without a temporary. Reusing a buffer avoids allocations for text that is rebuilt every frame.
+    {
+        std::stringstream &stream = impl::ss;
+        stream.flags(impl::stdfmt);
+        (impl::Append(stream, buffer, std::forward<P>(params)) , ...);
     }
 
     [[nodiscard]] inline std::string_view Trim(std::string_view str)
@@ -78,6 +217,20 @@ namespace Strings
         return ret;
     }
 
+    namespace impl
+    {
+        [[nodiscard]] inline const char *u8skipascii(const char *it, const char *end) // Skips 16-byte blocks of ASCII characters. Without SSE2 does nothing.
+        {
+            #ifdef __SSE2__
+            while (end - it >= 16 && !_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)it)))
+                it += 16;
+            #else
+            (void)end;
+            #endif
+            return it;
+        }
+    }
+
     inline namespace UTF8
     {
         constexpr uint16_t u8invalidchar = 0xffff;
@@ -94,21 +247,38 @@ namespace Strings
         [[nodiscard]] inline std::size_t u8strlen(std::string_view str)
         {
             std::size_t ret = 0;
-            for (char it : str)
-                if (u8isfirstbyte(it))
+            const char *it = str.data(), *end = it + str.size();
+
+            #ifdef __SSE2__
+            // Continuation bytes are 0x80..0xbf, which are exactly the signed bytes that are <= -65.
+            const __m128i threshold = _mm_set1_epi8(-65), zero = _mm_setzero_si128();
+            while (end - it >= 16)
+            {
+                __m128i counters = zero; // Per-byte counters, so at most 255 iterations before we sum them.
+                for (int i = 0; i < 255 && end - it >= 16; i++, it += 16)
+                    counters = _mm_sub_epi8(counters, _mm_cmpgt_epi8(_mm_loadu_si128((const __m128i *)it), threshold));
+                __m128i sums = _mm_sad_epu8(counters, zero);
+                ret += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums));
+            }
+            #endif
+
+            for (; it != end; it++)
+                if (u8isfirstbyte(*it))
                     ret++;
             return ret;
         }
 
         [[nodiscard]] inline std::size_t u8charlen(char ch) // If `ch` is not a first byte of a sequence, returns 0.
         {
-            if ((ch & 0b1000'0000) == 0)
-                return 1;
-            if (!u8isfirstbyte(ch))
-                return 0;
-            for (int i = 1; i < 8; i++)
-                if ((((ch & (0xff00 >> (i+1))) ^ (0xff00 >> i)) & 0xff) == 0)
-                    return i;
+            unsigned char byte = ch;
+            if (byte < 0b1000'0000) return 1;
+            if (byte < 0b1100'0000) return 0;
+            if (byte < 0b1110'0000) return 2;
+            if (byte < 0b1111'0000) return 3;
+            if (byte < 0b1111'1000) return 4;
+            if (byte < 0b1111'1100) return 5;
+            if (byte < 0b1111'1110) return 6;
+            if (byte < 0b1111'1111) return 7;
             return 8;
         }
         template <typename Iter> [[nodiscard]] std::size_t u8charlen(Iter it)
@@ -134,9 +304,17 @@ namespace Strings
         [[nodiscard]] inline bool u8valid16(std::string_view str)
         {
             std::size_t len = 0;
-            for (char it : str)
+            const char *it = str.data(), *end = it + str.size();
+            while (it != end)
             {
-                std::size_t cur_len = u8charlen(it);
+                if (len == 0 && (*it & 0b1000'0000) == 0)
+                {
+                    it = impl::u8skipascii(it, end);
+                    if (it == end)
+                        break;
+                }
+
+                std::size_t cur_len = u8charlen(*it++);
                 if (cur_len > 3)
                     return 0;
                 if (bool(cur_len) == bool(len))
@@ -147,16 +325,112 @@ namespace Strings
             }
             return 1;
         }
+
+        // Decodes the string, appending one element to `out` for each first byte of a sequence, so the indices match the ones counted by `u8strlen()`.
+        // Same as calling `u8decode()` on every first byte, except that sequences cut off by the end of the string give `u8invalidchar` too.
+        inline void u8decode16(std::string_view str, std::vector<uint16_t> &out)
+        {
+            std::size_t old_size = out.size();
+            out.resize(old_size + str.size()); // Each code point takes at least one byte.
+            uint16_t *dst = out.data() + old_size;
+
+            const char *it = str.data(), *end = it + str.size();
+            while (it != end)
+            {
+                #ifdef __SSE2__
+                const __m128i zero = _mm_setzero_si128();
+                while (end - it >= 16 && ((it[0] | it[1]) & 0b1000'0000) == 0) // Single ASCII characters, like spaces between words, aren't worth a block.
+                {
+                    // `dst` is never ahead of `it`, so there is room for 16 elements even if we keep only a part of them.
+                    __m128i block = _mm_loadu_si128((const __m128i *)it);
+                    _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi8(block, zero));
+                    _mm_storeu_si128((__m128i *)(dst + 8), _mm_unpackhi_epi8(block, zero));
+                    if (int mask = _mm_movemask_epi8(block))
+                    {
+                        int ascii_len = __builtin_ctz(mask); // Otherwise short ASCII runs between non-ASCII characters would be loaded once per byte.
+                        it += ascii_len;
+                        dst += ascii_len;
+                        break;
+                    }
+                    it += 16;
+                    dst += 16;
+                }
+                if (it == end)
+                    break;
+                #endif
+
+                if ((*it & 0b1000'0000) == 0)
+                {
+                    *dst++ = *it++;
+                    continue;
+                }
+
+                std::size_t len = u8charlen(*it);
+                if (len == 2 && end - it >= 2)
+                {
+                    *dst++ = ((*it & 0b0001'1111) << 6) | (it[1] & 0b0011'1111);
+                    it += u8isfirstbyte(it[1]) ? 1 : 2; // A broken sequence doesn't swallow the next character.
+                }
+                else if (len == 3 && end - it >= 3)
+                {
+                    *dst++ = ((*it & 0b0000'1111) << 12) | ((it[1] & 0b0011'1111) << 6) | (it[2] & 0b0011'1111);
+                    it++;
+                }
+                else
+                {
+                    if (len != 0)
+                        *dst++ = u8invalidchar;
+                    it++;
+                }
+            }
+
+            out.resize(dst - out.data());
+        }
     }
 
     inline namespace Encodings
     {
-        const uint16_t (&cp1251())[256];
+        const uint16_t (&cp1251())[256]; // Unassigned bytes map to `u8invalidchar`.
+
+        class Codepage // Converts between UTF-8 and a single-byte encoding.
+        {
+            const uint16_t (*table)[256];
+            char utf8[256][4]; // UTF-8 representation of each byte. The last element is the length.
+            uint8_t page_index[256]; // Indices into `pages`, one for each possible high byte of a code point. 0 means that no code points of that page are mapped.
+            std::vector<uint8_t> pages; // 256 bytes per page. 0 means not mapped, except for the code point 0.
+
+          public:
+            Codepage(const uint16_t (&table)[256]); // Unassigned bytes in the table should be `u8invalidchar`.
+
+            Codepage(const Codepage &) = delete;
+            Codepage &operator=(const Codepage &) = delete;
+
+            [[nodiscard]] const uint16_t (&Table() const)[256] {return *table;}
+
+            [[nodiscard]] uint16_t Decode(char ch) const // Returns `u8invalidchar` for unassigned bytes.
+            {
+                return (*table)[(unsigned char)ch];
+            }
+            [[nodiscard]] bool Encode(uint16_t ch, char &out) const // Returns 0 if the character can't be encoded.
+            {
+                uint8_t byte = pages[page_index[ch >> 8] * 256 + (ch & 0xff)];
+                if (byte == 0 && ch != 0)
+                    return 0;
+                out = byte;
+                return 1;
+            }
+
+            void ToUTF8(std::string_view str, std::string &out) const; // Appends to `out`. Unassigned bytes become U+FFFD.
+            bool FromUTF8(std::string_view str, std::string &out, char replacement = '?') const; // Appends to `out`. Returns 0 if some characters were invalid or couldn't be encoded and were replaced.
+        };
+
+        const Codepage &cp1251_codepage();
     }
 }
 
 using Strings::Str;
 using Strings::Str_;
+using Strings::StrAppend;
 using namespace Strings::UTF8;
 
 #endif
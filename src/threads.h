@@ -0,0 +1,358 @@
+#ifndef THREADS_H_INCLUDED
+#define THREADS_H_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "mat.h"
+#include "program.h"
+
+namespace Threads
+{
+    [[nodiscard]] inline int HardwareThreadCount() // Never returns less than 1.
+    {
+        unsigned int ret = std::thread::hardware_concurrency();
+        return ret ? ret : 1;
+    }
+
+    class Pool;
+
+    /* Counts unfinished jobs scheduled with `Pool::Schedule()`.
+     * Use `Pool::Wait()` to wait for it to reach zero, or pass it as a dependency of other jobs.
+     * Must outlive the jobs that use it.
+     */
+    class Counter
+    {
+        friend class Pool;
+
+        std::atomic_int value{0};
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<std::function<void()>> continuations; // Ran when `value` reaches zero.
+        std::exception_ptr error; // The first exception thrown by a job.
+
+      public:
+        Counter() {}
+
+        Counter(const Counter &) = delete;
+        Counter &operator=(const Counter &) = delete;
+
+        [[nodiscard]] bool Done() const
+        {
+            return value == 0;
+        }
+    };
+
+    /* A thread pool with work stealing.
+     * Each worker has its own queue. Jobs scheduled from a worker go to the back of its queue, and the worker takes them from the back,
+     * so nested jobs run while their data is still in the cache. Idle workers steal from the front of other queues.
+     * Jobs scheduled from other threads are spread over the queues.
+     */
+    class Pool
+    {
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<std::function<void()>> queue;
+        };
+
+        struct Data
+        {
+            std::vector<std::thread> threads;
+            std::vector<std::unique_ptr<Worker>> workers;
+            std::atomic<std::size_t> queued{0}; // Jobs in all queues.
+            std::atomic<std::size_t> next_queue{0}; // Where the next job from a non-worker thread goes.
+            std::mutex mutex; // Protects `stop`. Also used for sleeping.
+            std::condition_variable cv;
+            bool stop = 0;
+        };
+
+        std::unique_ptr<Data> data; // Worker threads store a pointer to this, so it shouldn't move.
+
+        inline static thread_local const Data *this_thread_data = 0; // Set for worker threads.
+        inline static thread_local std::size_t this_thread_index = 0;
+
+        static void Push(Data &d, std::function<void()> func)
+        {
+            std::size_t index = this_thread_data == &d ? this_thread_index : d.next_queue++ % d.workers.size();
+            {
+                std::lock_guard lock(d.workers[index]->mutex);
+                d.workers[index]->queue.push_back(std::move(func));
+            }
+            d.queued++;
+            {
+                std::lock_guard lock(d.mutex); // Otherwise a worker could check `queued` and fall asleep right before the notification.
+            }
+            d.cv.notify_one();
+        }
+
+        static bool RunOne(Data &d) // Runs one job, from the current worker's queue if possible. Returns 0 if there are no jobs.
+        {
+            if (d.queued == 0)
+                return 0;
+
+            std::function<void()> func;
+            bool own = this_thread_data == &d;
+            std::size_t first = own ? this_thread_index : d.next_queue % d.workers.size();
+            for (std::size_t i = 0; i < d.workers.size() && !func; i++)
+            {
+                Worker &worker = *d.workers[(first + i) % d.workers.size()];
+                std::lock_guard lock(worker.mutex);
+                if (worker.queue.empty())
+                    continue;
+                if (own && i == 0)
+                {
+                    func = std::move(worker.queue.back());
+                    worker.queue.pop_back();
+                }
+                else
+                {
+                    func = std::move(worker.queue.front());
+                    worker.queue.pop_front();
+                }
+            }
+            if (!func)
+                return 0;
+            d.queued--;
+            func();
+            return 1;
+        }
+
+        static void Finish(Data &d, Counter &counter)
+        {
+            std::vector<std::function<void()>> continuations;
+            {
+                std::lock_guard lock(counter.mutex);
+                if (--counter.value != 0)
+                    return;
+                std::swap(continuations, counter.continuations);
+                counter.cv.notify_all(); // Under the lock, because `Wait()` locks the mutex before returning, after which the counter can be destroyed.
+            }
+            for (auto &func : continuations)
+                Push(d, std::move(func));
+        }
+
+      public:
+        Pool() {}
+        Pool(int thread_count) // If `thread_count` is 0, it's set to one less than the hardware thread count (but at least 1).
+        {
+            Create(thread_count);
+        }
+
+        Pool(const Pool &) = delete;
+        Pool &operator=(const Pool &) = delete;
+
+        Pool(Pool &&) = default;
+        Pool &operator=(Pool &&other) noexcept
+        {
+            if (&other == this)
+                return *this;
+            Destroy();
+            data = std::move(other.data);
+            return *this;
+        }
+
+        ~Pool()
+        {
+            Destroy();
+        }
+
+        void Create(int thread_count = 0)
+        {
+            Destroy();
+
+            if (thread_count <= 0)
+                thread_count = std::max(1, HardwareThreadCount() - 1);
+
+            data = std::make_unique<Data>();
+            data->workers.reserve(thread_count);
+            for (int i = 0; i < thread_count; i++)
+                data->workers.push_back(std::make_unique<Worker>());
+
+            data->threads.reserve(thread_count);
+            for (int i = 0; i < thread_count; i++)
+            {
+                data->threads.emplace_back([d = data.get(), i]
+                {
+                    this_thread_data = d;
+                    this_thread_index = i;
+                    while (1)
+                    {
+                        if (RunOne(*d))
+                            continue;
+                        std::unique_lock lock(d->mutex);
+                        d->cv.wait(lock, [&]{return d->stop || d->queued > 0;});
+                        if (d->queued == 0) // This means `stop` is set.
+                            return;
+                    }
+                });
+            }
+        }
+        void Destroy() // Finishes all queued tasks before returning.
+        {
+            if (!data)
+                return;
+
+            {
+                std::lock_guard lock(data->mutex);
+                data->stop = 1;
+            }
+            data->cv.notify_all();
+            for (auto &it : data->threads)
+                it.join();
+            data = 0;
+        }
+        bool Exists() const
+        {
+            return bool(data);
+        }
+
+        [[nodiscard]] int ThreadCount() const
+        {
+            return data ? data->threads.size() : 0;
+        }
+
+        // Schedules `func()` to run on one of the worker threads.
+        // Exceptions thrown by `func` are stored in the returned future.
+        template <typename F> std::future<std::invoke_result_t<std::decay_t<F>>> Run(F &&func)
+        {
+            DebugAssert("Attempt to use a null thread pool.", Exists());
+
+            using return_type = std::invoke_result_t<std::decay_t<F>>;
+
+            // `std::function` requires copyable targets, so the task is stored in a shared pointer.
+            auto task = std::make_shared<std::packaged_task<return_type()>>(std::forward<F>(func));
+            std::future<return_type> ret = task->get_future();
+            Push(*data, [task = std::move(task)]{(*task)();});
+            return ret;
+        }
+
+        // Schedules `func()` to run on one of the worker threads. It's lighter than `Run()`, since there is no future.
+        // If `counter` isn't null, it's incremented now and decremented when `func` returns. Exceptions are stored in the counter and rethrown by `Wait()`.
+        // Without a counter, `func` must not throw.
+        // If `after` isn't null, `func` starts only after `after` reaches zero.
+        template <typename F> void Schedule(F &&func, Counter *counter = 0, Counter *after = 0)
+        {
+            DebugAssert("Attempt to use a null thread pool.", Exists());
+
+            if (counter)
+                counter->value++;
+
+            // `std::function` requires copyable targets, so the function is stored in a shared pointer.
+            std::function<void()> job = [d = data.get(), func = std::make_shared<std::decay_t<F>>(std::forward<F>(func)), counter]
+            {
+                if (!counter)
+                {
+                    (*func)();
+                    return;
+                }
+                try
+                {
+                    (*func)();
+                }
+                catch (...)
+                {
+                    std::lock_guard lock(counter->mutex);
+                    if (!counter->error)
+                        counter->error = std::current_exception();
+                }
+                Finish(*d, *counter);
+            };
+
+            if (after)
+            {
+                std::lock_guard lock(after->mutex);
+                if (after->value != 0)
+                {
+                    after->continuations.push_back(std::move(job));
+                    return;
+                }
+            }
+            Push(*data, std::move(job));
+        }
+
+        // Blocks until `counter` reaches zero, running queued jobs in the meantime. Can be called from the workers too.
+        // Rethrows the first exception thrown by the jobs, if any.
+        void Wait(Counter &counter)
+        {
+            DebugAssert("Attempt to use a null thread pool.", Exists());
+
+            while (!counter.Done())
+            {
+                if (RunOne(*data))
+                    continue;
+                // Nothing to do. Sleep until the counter is done, but wake up now and then to check for new jobs (the remaining ones might schedule more).
+                std::unique_lock lock(counter.mutex);
+                counter.cv.wait_for(lock, std::chrono::microseconds(200), [&]{return counter.Done();});
+            }
+
+            std::exception_ptr error;
+            {
+                std::lock_guard lock(counter.mutex);
+                std::swap(error, counter.error);
+            }
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+        // Calls `func(i)` for each `i` in `[begin, end)`, in parallel. Blocks until done. The calling thread helps. If the pool is null, runs everything on the calling thread.
+        // `per_job` is the number of iterations per job. If it's 0, the range is split into roughly 4 jobs per thread.
+        template <typename F> void ParallelFor(int begin, int end, F &&func, int per_job = 0)
+        {
+            if (begin >= end)
+                return;
+            if (per_job <= 0)
+                per_job = std::max(1, (end - begin) / ((ThreadCount() + 1) * 4));
+            if (!Exists() || end - begin <= per_job)
+            {
+                for (int i = begin; i < end; i++)
+                    func(i);
+                return;
+            }
+
+            Counter counter;
+            for (int first = begin;; first += per_job)
+            {
+                // Only differences with `end` are computed, since `first + per_job` could overflow when `end` is close to `INT_MAX`.
+                int last = first + std::min(per_job, end - first);
+                Schedule([&func, first, last]
+                {
+                    for (int i = first; i < last; i++)
+                        func(i);
+                }, &counter);
+                if (end - first <= per_job)
+                    break;
+            }
+            Wait(counter);
+        }
+
+        // Calls `func(ivec2(x,y))` for each point in `[begin, end)`, in parallel. Blocks until done.
+        // Each job gets whole rows, and iterates over them in the same order as the usual `for y for x` loops.
+        // `rows_per_job` works like `per_job` in the other overload.
+        template <typename F> void ParallelFor(ivec2 begin, ivec2 end, F &&func, int rows_per_job = 0)
+        {
+            if ((begin >= end).any())
+                return;
+            ParallelFor(begin.y, end.y, [&](int y)
+            {
+                for (int x = begin.x; x < end.x; x++)
+                    func(ivec2(x,y));
+            }, rows_per_job);
+        }
+    };
+}
+
+#endif
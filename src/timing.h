@@ -1,9 +1,21 @@
 #ifndef TIMING_H_INCLUDED
 #define TIMING_H_INCLUDED
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
 #include <SDL2/SDL.h>
 
 #include "mat.h"
+#include "program.h"
 
 namespace Timing
 {
@@ -137,6 +149,152 @@ namespace Timing
             return accumulator / double(tick_len);
         }
     };
+
+    /* Runs a fixed-rate simulation on its own thread, so that slow frames don't delay ticks and vice versa.
+     * `tick(snapshot)` advances the simulation (which should be owned by the tick function and not touched by other threads)
+     * and fills `snapshot` with everything the renderer needs. `snapshot` contains an older snapshot, so it must be overwritten entirely. The two latest snapshots are kept, and the renderer gets them
+     * with `Fetch()`, along with the interpolation fraction, which means the same thing as `TickStabilizer::Time()` in a single-threaded loop.
+     * Snapshots should be cheap to copy, since `Fetch()` copies both of them (or only the latest one, if the snapshot remembers the previous state itself).
+     * The copies are made with copy assignment into the same objects each time, so a snapshot type whose `operator=` reuses the existing memory (like `Scene`) doesn't allocate there.
+     */
+    template <typename S> class SimulationThread
+    {
+        struct Data
+        {
+            std::function<void(S &)> tick;
+            TickStabilizer stabilizer;
+            std::thread thread;
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool stop = 0;
+            S prev, cur; // The two latest snapshots.
+            uint64_t cur_time = 0; // When `cur` was published.
+            uint64_t ticks = 0;
+            std::exception_ptr error;
+        };
+
+        std::unique_ptr<Data> data; // The thread stores a pointer to this, so it shouldn't move.
+
+        static void Loop(Data &d)
+        {
+            S next = d.cur;
+            uint64_t last_time = Clock();
+            while (1)
+            {
+                uint64_t time = Clock();
+                uint64_t delta = time - last_time;
+                last_time = time;
+
+                while (d.stabilizer.Tick(delta))
+                {
+                    try
+                    {
+                        d.tick(next);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard lock(d.mutex);
+                        d.error = std::current_exception();
+                        return;
+                    }
+
+                    std::lock_guard lock(d.mutex);
+                    std::swap(d.prev, d.cur);
+                    std::swap(d.cur, next); // Now `next` holds the oldest snapshot, and will be overwritten by the next tick.
+                    d.cur_time = Clock();
+                    d.ticks++;
+                }
+
+                // Sleep until the next tick is due.
+                uint64_t wait = d.stabilizer.ClockTicksPerTick() * std::max(0., 1 - d.stabilizer.Time());
+                std::unique_lock lock(d.mutex);
+                if (d.cv.wait_for(lock, std::chrono::nanoseconds(uint64_t(TicksToSecs(wait) * 1e9)), [&]{return d.stop;}))
+                    return;
+            }
+        }
+
+      public:
+        SimulationThread() {}
+        SimulationThread(double freq, std::function<void(S &)> tick, const S &initial = {}, int max_ticks_per_frame = 8) // Both snapshots start as copies of `initial`.
+        {
+            Create(freq, std::move(tick), initial, max_ticks_per_frame);
+        }
+
+        SimulationThread(const SimulationThread &) = delete;
+        SimulationThread &operator=(const SimulationThread &) = delete;
+
+        SimulationThread(SimulationThread &&) = default;
+        SimulationThread &operator=(SimulationThread &&other) noexcept
+        {
+            if (&other == this)
+                return *this;
+            Destroy();
+            data = std::move(other.data);
+            return *this;
+        }
+
+        ~SimulationThread()
+        {
+            Destroy();
+        }
+
+        void Create(double freq, std::function<void(S &)> tick, const S &initial = {}, int max_ticks_per_frame = 8)
+        {
+            Destroy();
+            data = std::make_unique<Data>();
+            data->tick = std::move(tick);
+            data->stabilizer = TickStabilizer(freq, max_ticks_per_frame);
+            data->prev = initial;
+            data->cur = initial;
+            data->cur_time = Clock();
+            data->thread = std::thread([d = data.get()]{Loop(*d);});
+        }
+        void Destroy() // Waits for the current tick to finish.
+        {
+            if (!data)
+                return;
+            {
+                std::lock_guard lock(data->mutex);
+                data->stop = 1;
+            }
+            data->cv.notify_all();
+            data->thread.join();
+            data = 0;
+        }
+        bool Exists() const
+        {
+            return bool(data);
+        }
+
+        // Copies the two latest snapshots, and returns how far the rendering should be from `prev` to `cur`, from 0 to 1.
+        // If the tick function threw an exception, it's rethrown here. The thread is stopped in that case.
+        float Fetch(S &prev, S &cur) const
+        {
+            DebugAssert("Attempt to use a null simulation thread.", Exists());
+            std::lock_guard lock(data->mutex);
+            if (data->error)
+                std::rethrow_exception(data->error);
+            prev = data->prev;
+            cur = data->cur;
+            return std::min(1., (Clock() - data->cur_time) / double(data->stabilizer.ClockTicksPerTick()));
+        }
+        float Fetch(S &cur) const // Same, but copies only the latest snapshot.
+        {
+            DebugAssert("Attempt to use a null simulation thread.", Exists());
+            std::lock_guard lock(data->mutex);
+            if (data->error)
+                std::rethrow_exception(data->error);
+            cur = data->cur;
+            return std::min(1., (Clock() - data->cur_time) / double(data->stabilizer.ClockTicksPerTick()));
+        }
+
+        [[nodiscard]] uint64_t Ticks() const // The number of published snapshots.
+        {
+            DebugAssert("Attempt to use a null simulation thread.", Exists());
+            std::lock_guard lock(data->mutex);
+            return data->ticks;
+        }
+    };
 }
 
 #endif
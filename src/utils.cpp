@@ -0,0 +1,94 @@
+#include "utils.h"
+
+#if defined(_WIN32)
+#  define WIN32_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  define UTILS_POSIX_MMAP
+#endif
+
+namespace Utils::Files::impl
+{
+    #if defined(_WIN32)
+
+    MappedFile MapFile(const std::string &fname)
+    {
+        static const std::size_t page_size = []{SYSTEM_INFO info; GetSystemInfo(&info); return info.dwPageSize;}();
+
+        HANDLE file = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+        if (file == INVALID_HANDLE_VALUE)
+            return {};
+
+        LARGE_INTEGER size;
+        // The rest of the last page is filled with zeroes, which gives us the terminator. If there is no rest, we give up.
+        if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || uint64_t(size.QuadPart) > SIZE_MAX || size.QuadPart % page_size == 0)
+        {
+            CloseHandle(file);
+            return {};
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+        CloseHandle(file); // The mapping keeps the file open.
+        if (!mapping)
+            return {};
+
+        void *ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping); // The view keeps the mapping alive.
+        if (!ptr)
+            return {};
+
+        return {(const uint8_t *)ptr, std::size_t(size.QuadPart)};
+    }
+
+    void UnmapFile(const MappedFile &file)
+    {
+        UnmapViewOfFile(file.data);
+    }
+
+    #elif defined(UTILS_POSIX_MMAP)
+
+    MappedFile MapFile(const std::string &fname)
+    {
+        static const std::size_t page_size = sysconf(_SC_PAGESIZE);
+
+        int fd = open(fname.c_str(), O_RDONLY);
+        if (fd == -1)
+            return {};
+
+        struct stat info;
+        // The rest of the last page is filled with zeroes, which gives us the terminator. If there is no rest, we give up.
+        if (fstat(fd, &info) || info.st_size <= 0 || uint64_t(info.st_size) > SIZE_MAX || info.st_size % page_size == 0)
+        {
+            close(fd);
+            return {};
+        }
+
+        void *ptr = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // The mapping keeps the file open.
+        if (ptr == MAP_FAILED)
+            return {};
+
+        return {(const uint8_t *)ptr, std::size_t(info.st_size)};
+    }
+
+    void UnmapFile(const MappedFile &file)
+    {
+        munmap((void *)file.data, file.size);
+    }
+
+    #else
+
+    MappedFile MapFile(const std::string &)
+    {
+        return {};
+    }
+
+    void UnmapFile(const MappedFile &) {}
+
+    #endif
+}
@@ -5,10 +5,12 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <functional>
 #include <iterator>
 #include <memory>
 #include <new>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -304,6 +306,59 @@ namespace Utils
     };
 
 
+    class Interner // Assigns consecutive ids to strings. The hash table refers to strings by ids rather than by pointers, so copying and moving are safe.
+    {
+        std::vector<std::string> strings;
+        std::vector<int> slots; // Open addressing with linear probing. -1 means an empty slot. The size is 0 or a power of two.
+
+        [[nodiscard]] std::size_t FindSlot(std::string_view str) const // Returns the slot that contains `str`, or the empty slot where it should go.
+        {
+            std::size_t mask = slots.size() - 1;
+            std::size_t i = std::hash<std::string_view>{}(str) & mask;
+            while (slots[i] != -1 && strings[slots[i]] != str)
+                i = (i + 1) & mask;
+            return i;
+        }
+
+      public:
+        inline static constexpr int none = -1;
+
+        [[nodiscard]] int Find(std::string_view str) const // Returns `none` if the string wasn't added.
+        {
+            if (slots.empty())
+                return none;
+            return slots[FindSlot(str)];
+        }
+
+        int Add(std::string_view str) // Returns the id of the string, adding it if necessary.
+        {
+            if ((strings.size() + 1) * 2 > slots.size()) // Keep the load factor at most 1/2.
+            {
+                slots.assign(slots.size() ? slots.size() * 2 : 16, -1);
+                for (std::size_t i = 0; i < strings.size(); i++)
+                    slots[FindSlot(strings[i])] = i;
+            }
+
+            int &slot = slots[FindSlot(str)];
+            if (slot == -1)
+            {
+                slot = strings.size();
+                strings.emplace_back(str);
+            }
+            return slot;
+        }
+
+        [[nodiscard]] const std::string &String(int id) const
+        {
+            return strings[id];
+        }
+        [[nodiscard]] int Size() const
+        {
+            return strings.size();
+        }
+    };
+
+
     inline namespace Ranges
     {
         namespace impl
@@ -478,15 +533,163 @@ namespace Utils
             using FileHandle = Handle<FileHandleFuncs>;
         }
 
-        enum Compression {not_compressed, compressed};
+        enum Compression {not_compressed, compressed, mapped}; // `mapped` files are not compressed. They are memory-mapped instead of being copied when possible. Only map large files that nothing rewrites while they are in use: truncating a mapped file crashes the reader with SIGBUS, and on Windows the writer fails instead.
 
-        class MemoryFile // Manages a ref-counted memory copy of a file. The data is always null-terminated, '\0' doesn't count against size.
+        namespace impl
+        {
+            struct MappedFile
+            {
+                const uint8_t *data = 0; // Null on failure.
+                std::size_t size = 0;
+            };
+
+            // Maps a file for reading. The mapping is always followed by a readable zero byte, if that's not possible the function fails.
+            // Those are implemented in `utils.cpp`, to keep platform headers out of here.
+            MappedFile MapFile(const std::string &fname);
+            void UnmapFile(const MappedFile &file);
+        }
+
+
+        class InflateStream // Decompresses a file written with `WriteToFile(..., compressed)` in chunks, without loading all of it at once. Errors are reported with `file_input_error`.
+        {
+            struct Data
+            {
+                std::string name;
+                impl::FileHandle input;
+                z_stream stream{};
+                bool stream_exists = 0, finished = 0;
+                uint32_t size = 0, size_produced = 0; // Uncompressed.
+                std::unique_ptr<uint8_t[]> in_buf, out_buf; // `out_buf` is allocated lazily by `NextChunk()`.
+
+                Data() {}
+                Data(const Data &) = delete;
+                Data &operator=(const Data &) = delete;
+                ~Data()
+                {
+                    if (stream_exists)
+                        inflateEnd(&stream);
+                }
+            };
+            std::unique_ptr<Data> data; // zlib doesn't like when `z_stream` is moved, so it's stored on the heap.
+
+          public:
+            inline static constexpr std::size_t chunk_size = 0x10000;
+
+            InflateStream() {}
+            InflateStream(std::string fname)
+            {
+                Create(fname);
+            }
+            void Create(std::string fname)
+            {
+                auto new_data = std::make_unique<Data>();
+                new_data->name = fname;
+                new_data->input.create({fname.c_str(), "rb"});
+
+                if (!std::fread(&new_data->size, sizeof new_data->size, 1, *new_data->input))
+                    throw file_input_error(fname, "Unable to decompress (too small).");
+                Reflection::Bytes::fix_order(new_data->size);
+
+                if (inflateInit(&new_data->stream) != Z_OK)
+                    throw file_input_error(fname, "Unable to initialize decompression.");
+                new_data->stream_exists = 1;
+                new_data->in_buf = std::make_unique<uint8_t[]>(chunk_size);
+
+                data = std::move(new_data);
+            }
+            void Destroy()
+            {
+                data.reset();
+            }
+            bool Exists() const
+            {
+                return bool(data);
+            }
+
+            [[nodiscard]] std::size_t Size() const // Uncompressed size, as stored in the file header.
+            {
+                return data->size;
+            }
+            [[nodiscard]] bool Finished() const // Returns 1 if all the data was decompressed.
+            {
+                return data->finished;
+            }
+            const std::string &Name() const
+            {
+                return data->name;
+            }
+
+            std::size_t Read(uint8_t *dst, std::size_t len) // Returns the amount of bytes written. It's less than `len` only if there is no more data.
+            {
+                z_stream &stream = data->stream;
+                stream.next_out = dst;
+                stream.avail_out = std::min(std::min(uint64_t(len), uint64_t(data->size - data->size_produced) + 1), uint64_t(uInt(-1))); // +1 lets us notice if there is more data than the header says.
+
+                while (stream.avail_out > 0 && !data->finished)
+                {
+                    if (stream.avail_in == 0)
+                    {
+                        stream.next_in = data->in_buf.get();
+                        stream.avail_in = std::fread(data->in_buf.get(), 1, chunk_size, *data->input);
+                        if (std::ferror(*data->input))
+                            throw file_input_error(data->name, "Unable to read.");
+                        if (stream.avail_in == 0)
+                            throw file_input_error(data->name, "Unable to decompress (unexpected end of file).");
+                    }
+
+                    int status = inflate(&stream, Z_NO_FLUSH);
+                    if (status == Z_STREAM_END)
+                        data->finished = 1;
+                    else if (status != Z_OK)
+                        throw file_input_error(data->name, "Unable to decompress.");
+                }
+
+                std::size_t ret = stream.next_out - dst;
+                data->size_produced += ret;
+                if (data->size_produced > data->size || (data->finished && data->size_produced != data->size))
+                    throw file_input_error(data->name, "Compressed data size mismatch.");
+                return ret;
+            }
+
+            bool NextChunk(const uint8_t *&begin, const uint8_t *&end) // Returns 0 if there is no more data. The chunk remains valid until the next call.
+            {
+                if (!data->out_buf)
+                    data->out_buf = std::make_unique<uint8_t[]>(chunk_size);
+                std::size_t len = Read(data->out_buf.get(), chunk_size);
+                begin = data->out_buf.get();
+                end = begin + len;
+                return len > 0;
+            }
+
+            [[nodiscard]] Reflection::Bytes::Reader Reader() // The stream must outlive the returned object.
+            {
+                return Reflection::Bytes::Reader([this](const uint8_t *&begin, const uint8_t *&end){return NextChunk(begin, end);});
+            }
+        };
+
+
+
+        class MemoryFile // Manages a ref-counted memory copy (or a read-only mapping) of a file. The data is always null-terminated, '\0' doesn't count against size.
         {
             struct Object
             {
                 std::string name;
-                std::size_t size;
-                std::unique_ptr<uint8_t[]> bytes;
+                std::size_t size = 0;
+                const uint8_t *bytes = 0; // Points either to `buffer` or to `mapping`.
+                std::unique_ptr<uint8_t[]> buffer;
+                impl::MappedFile mapping;
+
+                Object(std::string name, std::size_t size, std::unique_ptr<uint8_t[]> buffer) : name(std::move(name)), size(size), bytes(buffer.get()), buffer(std::move(buffer)) {}
+                Object(std::string name, impl::MappedFile mapping) : name(std::move(name)), size(mapping.size), bytes(mapping.data), mapping(mapping) {}
+
+                Object(const Object &) = delete;
+                Object &operator=(const Object &) = delete;
+
+                ~Object()
+                {
+                    if (mapping.data)
+                        impl::UnmapFile(mapping);
+                }
             };
             std::shared_ptr<Object> data;
 
@@ -503,6 +706,29 @@ namespace Utils
             }
             void Create(std::string fname, Compression mode = not_compressed)
             {
+                if (mode == mapped)
+                {
+                    if (impl::MappedFile mapping = impl::MapFile(fname); mapping.data)
+                    {
+                        data = std::make_shared<Object>(fname, mapping);
+                        return;
+                    }
+                    mode = not_compressed; // Fall back to a copy. This happens for empty files, for files with sizes that are multiples of the page size (so there is no room for '\0'), and if mapping isn't supported.
+                }
+
+                if (mode == compressed)
+                {
+                    // Decompressing straight into the final buffer, so the compressed data is never loaded in its entirety.
+                    InflateStream input(fname);
+                    std::size_t size = input.Size();
+                    auto buf = std::make_unique<uint8_t[]>(size+1); // +1 to make space for '\0'.
+                    buf[size] = '\0';
+                    if (input.Read(buf.get(), size) != size || input.Read(buf.get() + size, 1) != 0 || !input.Finished())
+                        throw file_input_error(fname, "Compressed data size mismatch.");
+                    data = std::make_shared<Object>(fname, size, std::move(buf));
+                    return;
+                }
+
                 impl::FileHandle input({fname.c_str(), "rb"});
 
                 std::fseek(*input, 0, SEEK_END);
@@ -511,34 +737,12 @@ namespace Utils
                 if (std::ferror(*input) || size == EOF)
                     throw file_input_error(fname, "Unable to get file size.");
 
-                auto buf = std::make_unique<uint8_t[]>(mode == not_compressed ? size+1 : size); // +1 to make space for '\0' if it's not compressed.
+                auto buf = std::make_unique<uint8_t[]>(size+1); // +1 to make space for '\0'.
                 if (!std::fread(buf.get(), size, 1, *input))
                     throw file_input_error(fname, "Unable to read.");
 
-                switch (mode)
-                {
-                  case not_compressed:
-                    buf[size] = '\0';
-                    data = std::make_shared<Object>(Object{fname, (std::size_t)size, std::move(buf)});
-                    break;
-                  case compressed:
-                    {
-                        uint32_t uncompr_size;
-                        if (!Reflection::from_bytes(uncompr_size, buf.get(), buf.get() + size))
-                            throw file_input_error(fname, "Unable to decompress (too small).");
-
-                        auto uncompr_buf = std::make_unique<uint8_t[]>(uncompr_size+1); // +1 to make space for '\0'.
-                        uncompr_buf[uncompr_size] = '\0';
-                        uLongf uncompr_size_real = uncompr_size;
-                        if (uncompress(uncompr_buf.get(), &uncompr_size_real, buf.get()+4, size-4) != Z_OK)
-                            throw file_input_error(fname, "Unable to decompress.");
-                        if (uncompr_size != uncompr_size_real)
-                            throw file_input_error(fname, "Compressed data size mismatch.");
-
-                        data = std::make_shared<Object>(Object{fname, (std::size_t)uncompr_size, std::move(uncompr_buf)});
-                    }
-                    break;
-                }
+                buf[size] = '\0';
+                data = std::make_shared<Object>(fname, (std::size_t)size, std::move(buf));
             }
             void Destroy()
             {
@@ -550,7 +754,7 @@ namespace Utils
             }
             const uint8_t *Data() const
             {
-                return data->bytes.get();
+                return data->bytes;
             }
             std::size_t Size() const
             {
@@ -571,6 +775,7 @@ namespace Utils
                 switch (mode)
                 {
                   case not_compressed:
+                  case mapped:
                     if (!std::fwrite(buf, len, 1, *output))
                         return 0;
                     break;
@@ -598,6 +803,18 @@ namespace Utils
             }
             return 1;
         }
+        template <typename F> bool WriteToFile(std::string fname, F &&func) // Opens the file and calls `func(FILE *)`, which should return 0 on failure. Useful for writing data without a temporary buffer.
+        {
+            try
+            {
+                impl::FileHandle output({fname.c_str(), "wb"});
+                return bool(func(*output));
+            }
+            catch (decltype(file_input_error("","")) &e)
+            {
+                return 0;
+            }
+        }
     }
 
 